@@ -8,7 +8,17 @@
  * License version 2. This program is licensed "as is" without any
  * warranty of any kind, whether express or implied.
  */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
 #include <linux/module.h>
+#include <linux/bsearch.h>
+#include <linux/mutex.h>
+#include <linux/pci.h>
+#include <linux/sizes.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/string.h>
 #include "low_level_access.h"
 #include "bios_data_access.h"
 
@@ -24,1078 +34,1460 @@
 #define extract_bits_shifted(type, value, start, size)                         \
 	(extract_bits(type, value, start, size) >> (start))
 
-static int read_SBASE_atom_avn_byt(struct SBASE_atom_avn_byt *reg)
+enum RegisterAccess { RegAccess_PCI, RegAccess_SPIBAR };
+
+struct RegisterField {
+	u8 start;
+	u8 size; /* 0 if the arch hasn't this field */
+	bool in_place; /* keep the bits at their position, e.g. addresses */
+};
+
+struct RegisterDescriptor {
+	enum RegisterAccess access;
+	u8 bus; /* PCI only */
+	u8 device; /* PCI only */
+	u8 function; /* PCI only */
+	u16 offset; /* in PCI config space or from SPIBAR */
+	u8 width; /* in bytes */
+	const struct RegisterField *fields;
+};
+
+#define FIELD(Start, Size)                                                     \
+	{                                                                      \
+		.start = (Start), .size = (Size)                               \
+	}
+#define FIELD_IN_PLACE(Start, Size)                                            \
+	{                                                                      \
+		.start = (Start), .size = (Size), .in_place = true             \
+	}
+
+static const struct RegisterField
+	SBASE_atom_avn_byt_fields[SBASE_Fields_count] = {
+		[SBASE_MEMI] = FIELD(0, 1),
+		[SBASE_Enable] = FIELD(1, 1),
+		[SBASE_ADDRNG] = FIELD(2, 1),
+		[SBASE_PREF] = FIELD(3, 1),
+		[SBASE_Base] = FIELD_IN_PLACE(9, 23),
+	};
+
+static const struct RegisterDescriptor SBASE_atom_avn_byt = {
+	.access = RegAccess_PCI,
+	.bus = 0x0,
+	.device = 0x1f,
+	.function = 0x0,
+	.offset = 0x54,
+	.width = sizeof(u32),
+	.fields = SBASE_atom_avn_byt_fields,
+};
+
+static const struct RegisterField BC_pch_3xx_4xx_5xx_fields[BC_Fields_count] = {
+	[BC_BIOSWE] = FIELD(0, 1),
+	[BC_BLE] = FIELD(1, 1),
+	[BC_SRC] = FIELD(2, 2),
+	[BC_TSS] = FIELD(4, 1),
+	[BC_SMM_BWP] = FIELD(5, 1),
+	[BC_BBS] = FIELD(6, 1),
+	[BC_BILD] = FIELD(7, 1),
+	[BC_SPI_SYNC_SS] = FIELD(8, 1),
+	[BC_SPI_ASYNC_SS] = FIELD(10, 1),
+	[BC_ASE_BWP] = FIELD(11, 1),
+};
+
+static const struct RegisterDescriptor BC_pch_3xx_4xx_5xx = {
+	.access = RegAccess_PCI,
+	.bus = 0x0,
+	.device = 0x1f,
+	.function = 0x5,
+	.offset = 0xdc,
+	.width = sizeof(u32),
+	.fields = BC_pch_3xx_4xx_5xx_fields,
+};
+
+static const struct RegisterField
+	BC_cpu_snb_jkt_ivb_ivt_bdx_hsx_fields[BC_Fields_count] = {
+		[BC_BIOSWE] = FIELD(0, 1),
+		[BC_BLE] = FIELD(1, 1),
+		[BC_SRC] = FIELD(2, 2),
+		[BC_TSS] = FIELD(4, 1),
+		[BC_SMM_BWP] = FIELD(5, 1),
+	};
+
+static const struct RegisterDescriptor BC_cpu_snb_jkt_ivb_ivt_bdx_hsx = {
+	.access = RegAccess_PCI,
+	.bus = 0x0,
+	.device = 0x1f,
+	.function = 0x5,
+	.offset = 0xdc,
+	.width = sizeof(u32),
+	.fields = BC_cpu_snb_jkt_ivb_ivt_bdx_hsx_fields,
+};
+
+static const struct RegisterField BC_cpu_skl_kbl_cfl_fields[BC_Fields_count] = {
+	[BC_BIOSWE] = FIELD(0, 1),
+	[BC_BLE] = FIELD(1, 1),
+	[BC_SRC] = FIELD(2, 2),
+	[BC_TSS] = FIELD(4, 1),
+	[BC_SMM_BWP] = FIELD(5, 1),
+	[BC_BBS] = FIELD(6, 1),
+	[BC_BILD] = FIELD(7, 1),
+};
+
+static const struct RegisterDescriptor BC_cpu_skl_kbl_cfl = {
+	.access = RegAccess_PCI,
+	.bus = 0x0,
+	.device = 0x1f,
+	.function = 0x5,
+	.offset = 0xdc,
+	.width = sizeof(u32),
+	.fields = BC_cpu_skl_kbl_cfl_fields,
+};
+
+static const struct RegisterField BC_cpu_apl_glk_fields[BC_Fields_count] = {
+	[BC_BIOSWE] = FIELD(0, 1),
+	[BC_BLE] = FIELD(1, 1),
+	[BC_SRC] = FIELD(2, 2),
+	[BC_TSS] = FIELD(4, 1),
+	[BC_SMM_BWP] = FIELD(5, 1),
+	[BC_BBS] = FIELD(6, 1),
+	[BC_BILD] = FIELD(7, 1),
+	[BC_SPI_SYNC_SS] = FIELD(8, 1),
+	[BC_OSFH] = FIELD(9, 1),
+	[BC_SPI_ASYNC_SS] = FIELD(10, 1),
+	[BC_ASE_BWP] = FIELD(11, 1),
+};
+
+static const struct RegisterDescriptor BC_cpu_apl_glk = {
+	.access = RegAccess_PCI,
+	.bus = 0x0,
+	.device = 0xd,
+	.function = 0x2,
+	.offset = 0xdc,
+	.width = sizeof(u32),
+	.fields = BC_cpu_apl_glk_fields,
+};
+
+static const struct RegisterField BC_cpu_atom_avn_fields[BC_Fields_count] = {
+	[BC_BIOSWE] = FIELD(0, 1),
+	[BC_BLE] = FIELD(1, 1),
+	[BC_SRC] = FIELD(2, 2),
+	[BC_TSS] = FIELD(4, 1),
+	[BC_SMM_BWP] = FIELD(5, 1),
+};
+
+static const struct RegisterDescriptor BC_cpu_atom_avn = {
+	.access = RegAccess_SPIBAR,
+	.offset = 0xfc,
+	.width = sizeof(u8),
+	.fields = BC_cpu_atom_avn_fields,
+};
+
+static const struct RegisterField BC_cpu_atom_byt_fields[BC_Fields_count] = {
+	[BC_BIOSWE] = FIELD(0, 1),
+	[BC_BLE] = FIELD(1, 1),
+	[BC_SRC] = FIELD(2, 2),
+	[BC_SMM_BWP] = FIELD(5, 1),
+};
+
+static const struct RegisterDescriptor BC_cpu_atom_byt = {
+	.access = RegAccess_SPIBAR,
+	.offset = 0xfc,
+	.width = sizeof(u32),
+	.fields = BC_cpu_atom_byt_fields,
+};
+
+#undef FIELD
+#undef FIELD_IN_PLACE
+
+/* Indexed by arch, NULL if the arch hasn't the register */
+static const struct RegisterDescriptor
+	*const SBASE_cpu_descriptors[CPU_Archs_count] = {
+		[cpu_avn] = &SBASE_atom_avn_byt,
+		[cpu_byt] = &SBASE_atom_avn_byt,
+	};
+
+static const struct RegisterDescriptor
+	*const BC_pch_descriptors[PCH_Archs_count] = {
+		[pch_3xx] = &BC_pch_3xx_4xx_5xx,
+		[pch_4xx] = &BC_pch_3xx_4xx_5xx,
+		[pch_495] = &BC_pch_3xx_4xx_5xx,
+		[pch_5xx] = &BC_pch_3xx_4xx_5xx,
+	};
+
+static const struct RegisterDescriptor
+	*const BC_cpu_descriptors[CPU_Archs_count] = {
+		[cpu_snb] = &BC_cpu_snb_jkt_ivb_ivt_bdx_hsx,
+		[cpu_jkt] = &BC_cpu_snb_jkt_ivb_ivt_bdx_hsx,
+		[cpu_ivb] = &BC_cpu_snb_jkt_ivb_ivt_bdx_hsx,
+		[cpu_ivt] = &BC_cpu_snb_jkt_ivb_ivt_bdx_hsx,
+		[cpu_bdw] = &BC_cpu_snb_jkt_ivb_ivt_bdx_hsx,
+		[cpu_bdx] = &BC_cpu_snb_jkt_ivb_ivt_bdx_hsx,
+		[cpu_hsx] = &BC_cpu_snb_jkt_ivb_ivt_bdx_hsx,
+		[cpu_hsw] = &BC_cpu_snb_jkt_ivb_ivt_bdx_hsx,
+		[cpu_skl] = &BC_cpu_skl_kbl_cfl,
+		[cpu_kbl] = &BC_cpu_skl_kbl_cfl,
+		[cpu_cfl] = &BC_cpu_skl_kbl_cfl,
+		[cpu_apl] = &BC_cpu_apl_glk,
+		[cpu_glk] = &BC_cpu_apl_glk,
+		[cpu_avn] = &BC_cpu_atom_avn,
+		[cpu_byt] = &BC_cpu_atom_byt,
+	};
+
+static const char *const SBASE_field_names[SBASE_Fields_count] = {
+	[SBASE_MEMI] = "SBASE_MEMI",
+	[SBASE_Enable] = "SBASE_Enable",
+	[SBASE_ADDRNG] = "SBASE_ADDRNG",
+	[SBASE_PREF] = "SBASE_PREF",
+	[SBASE_Base] = "SBASE_Base",
+};
+
+static const char *const BC_field_names[BC_Fields_count] = {
+	[BC_BIOSWE] = "BC_BIOSWE",
+	[BC_BLE] = "BC_BLE",
+	[BC_SRC] = "BC_SRC",
+	[BC_TSS] = "BC_TSS",
+	[BC_SMM_BWP] = "BC_SMM_BWP",
+	[BC_BBS] = "BC_BBS",
+	[BC_BILD] = "BC_BILD",
+	[BC_SPI_SYNC_SS] = "BC_SPI_SYNC_SS",
+	[BC_OSFH] = "BC_OSFH",
+	[BC_SPI_ASYNC_SS] = "BC_SPI_ASYNC_SS",
+	[BC_ASE_BWP] = "BC_ASE_BWP",
+};
+
+static const struct RegisterDescriptor *
+find_descriptor(const struct RegisterArch *register_arch,
+		const struct RegisterDescriptor *const *pch_descriptors,
+		const struct RegisterDescriptor *const *cpu_descriptors)
 {
-	u32 value;
-	const int ret = pci_read_dword(&value, 0x0, 0x1f, 0x0, 0x54);
+	switch (register_arch->source) {
+	case RegSource_PCH:
+		if (pch_descriptors == NULL ||
+		    register_arch->pch_arch >= PCH_Archs_count)
+			return NULL;
+		return pch_descriptors[register_arch->pch_arch];
+	case RegSource_CPU:
+		if (cpu_descriptors == NULL ||
+		    register_arch->cpu_arch >= CPU_Archs_count)
+			return NULL;
+		return cpu_descriptors[register_arch->cpu_arch];
+	default:
+		return NULL; /* should not reach here, it's a bug */
+	}
+}
 
-	if (ret != 0)
-		return ret;
+static int read_register(const struct RegisterDescriptor *desc,
+			 enum PCH_Arch pch_arch, enum CPU_Arch cpu_arch,
+			 u32 *value)
+{
+	int ret;
+	u8 value8;
+	u64 barOffset;
 
-	reg->MEMI = extract_bits_shifted(u32, value, 0, 1);
-	reg->Enable = extract_bits_shifted(u32, value, 1, 1);
-	reg->ADDRNG = extract_bits_shifted(u32, value, 2, 1);
-	reg->PREF = extract_bits_shifted(u32, value, 3, 1);
-	reg->Base = extract_bits(u32, value, 9, 23);
+	switch (desc->access) {
+	case RegAccess_PCI:
+		if (desc->width == sizeof(u8)) {
+			ret = pci_read_byte(&value8, desc->bus, desc->device,
+					    desc->function, desc->offset);
+			*value = value8;
+			return ret;
+		}
+		return pci_read_dword(value, desc->bus, desc->device,
+				      desc->function, desc->offset);
+	case RegAccess_SPIBAR:
+		ret = read_SPIBAR(pch_arch, cpu_arch, &barOffset);
+		if (ret != 0)
+			return ret;
+		if (desc->width == sizeof(u8)) {
+			ret = mmio_read_byte(barOffset + desc->offset, &value8);
+			*value = value8;
+			return ret;
+		}
+		return mmio_read_dword(barOffset + desc->offset, value);
+	default:
+		return -EIO; /* should not reach here, it's a bug */
+	}
+}
 
+static u64 extract_field(const struct RegisterField *field, u32 value)
+{
+	if (field->in_place)
+		return extract_bits(u32, value, field->start, field->size);
+	return extract_bits_shifted(u32, value, field->start, field->size);
+}
+
+static int read_field(const struct RegisterDescriptor *desc, u32 raw,
+		      size_t count, int field, u64 *value)
+{
+	*value = 0;
+	if (desc == NULL || field < 0 || (size_t)field >= count)
+		return -EIO;
+	if (desc->fields[field].size == 0)
+		return -EIO; /* requested arch hasn't this field */
+
+	*value = extract_field(&desc->fields[field], raw);
+	return 0;
+}
+
+static int visit_fields(const struct RegisterDescriptor *desc,
+			const char *const *names, u32 raw, size_t count,
+			Register_Field_Visitor *visitor, void *ctx)
+{
+	size_t i;
+
+	if (desc == NULL)
+		return -EIO;
+
+	for (i = 0; i < count; i++) {
+		if (desc->fields[i].size != 0)
+			visitor(ctx, i, names[i],
+				extract_field(&desc->fields[i], raw));
+	}
 	return 0;
 }
 
-int read_SBASE(enum PCH_Arch pch_arch __maybe_unused, enum CPU_Arch cpu_arch,
+int read_SBASE(enum PCH_Arch pch_arch, enum CPU_Arch cpu_arch,
 	       struct SBASE *reg)
 {
-	int ret = 0;
+	const struct RegisterDescriptor *desc;
+
+	memset(reg, 0, sizeof(*reg));
 	reg->register_arch.source = RegSource_CPU;
 	reg->register_arch.cpu_arch = cpu_arch;
+
+	desc = find_descriptor(&reg->register_arch, NULL,
+			       SBASE_cpu_descriptors);
+	if (desc == NULL)
+		return -EIO;
+
+	return read_register(desc, pch_arch, cpu_arch, &reg->raw);
+}
+
+int read_BC(enum PCH_Arch pch_arch, enum CPU_Arch cpu_arch, struct BC *reg)
+{
+	const struct RegisterDescriptor *desc;
+
+	/* struct RegisterArch stores the archs as bytes */
+	BUILD_BUG_ON(PCH_Archs_count > U8_MAX || CPU_Archs_count > U8_MAX);
+
+	memset(reg, 0, sizeof(*reg));
+	reg->register_arch.source = RegSource_PCH;
+	reg->register_arch.pch_arch = pch_arch;
+
+	desc = find_descriptor(&reg->register_arch, BC_pch_descriptors, NULL);
+	if (desc == NULL) {
+		reg->register_arch.source = RegSource_CPU;
+		reg->register_arch.cpu_arch = cpu_arch;
+		desc = find_descriptor(&reg->register_arch, NULL,
+				       BC_cpu_descriptors);
+	}
+	if (desc == NULL)
+		return -EIO;
+
+	return read_register(desc, pch_arch, cpu_arch, &reg->raw);
+}
+
+/*
+ * SPIBAR only changes on reset, so it's resolved once per detected arch. The
+ * first call happens during detection, later calls only read the cache.
+ */
+static DEFINE_MUTEX(spibar_lock);
+static struct {
+	bool valid;
+	enum PCH_Arch pch_arch;
+	enum CPU_Arch cpu_arch;
+	int status;
+	u64 offset;
+} spibar_cache;
+
+static int read_SPIBAR_SBASE(enum PCH_Arch pch_arch, enum CPU_Arch cpu_arch,
+			     u64 *offset)
+{
+	struct SBASE reg;
+	int ret = read_SBASE(pch_arch, cpu_arch, &reg);
+
+	if (ret == 0)
+		ret = read_SBASE_Base(&reg, offset);
+	return ret;
+}
+
+/*
+ * The SPI controller is a PCI device and SPIBAR is its BAR0. This only reads
+ * it while the device is visible: a firmware that hides it can only be worked
+ * around by unhiding it through config space, and this module never writes
+ * there, so a hidden controller is only detected and reported as -ENODEV.
+ */
+static int read_visible_SPIBAR_BAR0(u8 device, u8 function, u64 *offset)
+{
+	u32 value;
+	int ret = pci_read_dword(&value, 0x0, device, function, PCI_VENDOR_ID);
+
+	if (ret != 0)
+		return ret;
+
+	/* a hidden device doesn't decode config cycles and reads as ones */
+	if (value == U32_MAX) {
+		pr_warn("SPI controller 0:%x.%x is hidden, no SPIBAR\n", device,
+			function);
+		return -ENODEV;
+	}
+
+	ret = pci_read_dword(&value, 0x0, device, function,
+			     PCI_BASE_ADDRESS_0);
+	if (ret != 0)
+		return ret;
+
+	*offset = value & PCI_BASE_ADDRESS_MEM_MASK;
+	return *offset != 0 ? 0 : -ENODEV; /* BAR not assigned */
+}
+
+/* Returns -ENODEV where the SPI controller isn't a PCI function of its own */
+int find_SPI_controller(enum PCH_Arch pch_arch, enum CPU_Arch cpu_arch,
+			u8 *device, u8 *function)
+{
+	switch (cpu_arch) {
+	case cpu_apl:
+	case cpu_glk:
+		*device = 0xd;
+		*function = 0x2;
+		return 0;
+	default:
+		break;
+	}
+
+	switch (pch_arch) {
+	case pch_1xx:
+	case pch_c620:
+	case pch_2xx:
+	case pch_3xx:
+	case pch_4xx:
+	case pch_495:
+	case pch_5xx:
+		*device = 0x1f;
+		*function = 0x5;
+		return 0;
+	default:
+		return -ENODEV;
+	}
+}
+
+static int resolve_SPIBAR(enum PCH_Arch pch_arch, enum CPU_Arch cpu_arch,
+			  u64 *offset)
+{
+	u8 device;
+	u8 function;
+
 	switch (cpu_arch) {
 	case cpu_avn:
 	case cpu_byt:
-		ret = read_SBASE_atom_avn_byt(&reg->cpu_byt);
-		break;
+		return read_SPIBAR_SBASE(pch_arch, cpu_arch, offset);
 	default:
-		ret = -EIO;
+		break;
 	}
+
+	if (find_SPI_controller(pch_arch, cpu_arch, &device, &function) != 0)
+		return -EIO;
+
+	return read_visible_SPIBAR_BAR0(device, function, offset);
+}
+
+int read_SPIBAR(enum PCH_Arch pch_arch, enum CPU_Arch cpu_arch, u64 *offset)
+{
+	int ret;
+
+	mutex_lock(&spibar_lock);
+	if (!spibar_cache.valid || spibar_cache.pch_arch != pch_arch ||
+	    spibar_cache.cpu_arch != cpu_arch) {
+		spibar_cache.status = resolve_SPIBAR(pch_arch, cpu_arch,
+						     &spibar_cache.offset);
+		spibar_cache.pch_arch = pch_arch;
+		spibar_cache.cpu_arch = cpu_arch;
+		spibar_cache.valid = true;
+	}
+
+	ret = spibar_cache.status;
+	if (ret == 0)
+		*offset = spibar_cache.offset;
+	mutex_unlock(&spibar_lock);
 	return ret;
 }
 
-static int read_BC_pch_3xx_4xx_5xx(struct BC_pch_3xx_4xx_5xx *reg)
+int read_BC_field(const struct BC *reg, enum BC_Field field, u64 *value)
 {
-	u32 value;
-	const int ret = pci_read_dword(&value, 0x0, 0x1f, 0x5, 0xdc);
+	return read_field(find_descriptor(&reg->register_arch,
+					  BC_pch_descriptors,
+					  BC_cpu_descriptors),
+			  reg->raw, BC_Fields_count, field, value);
+}
 
-	if (ret != 0)
-		return ret;
+int read_SBASE_field(const struct SBASE *reg, enum SBASE_Field field,
+		     u64 *value)
+{
+	return read_field(find_descriptor(&reg->register_arch, NULL,
+					  SBASE_cpu_descriptors),
+			  reg->raw, SBASE_Fields_count, field, value);
+}
 
-	reg->BIOSWE = extract_bits_shifted(u32, value, 0, 1);
-	reg->BLE = extract_bits_shifted(u32, value, 1, 1);
-	reg->SRC = extract_bits_shifted(u32, value, 2, 2);
-	reg->TSS = extract_bits_shifted(u32, value, 4, 1);
-	reg->SMM_BWP = extract_bits_shifted(u32, value, 5, 1);
-	reg->BBS = extract_bits_shifted(u32, value, 6, 1);
-	reg->BILD = extract_bits_shifted(u32, value, 7, 1);
-	reg->SPI_SYNC_SS = extract_bits_shifted(u32, value, 8, 1);
-	reg->SPI_ASYNC_SS = extract_bits_shifted(u32, value, 10, 1);
-	reg->ASE_BWP = extract_bits_shifted(u32, value, 11, 1);
+int read_BC_BIOSWE(const struct BC *reg, u64 *value)
+{
+	return read_BC_field(reg, BC_BIOSWE, value);
+}
 
-	return 0;
+int read_BC_BLE(const struct BC *reg, u64 *value)
+{
+	return read_BC_field(reg, BC_BLE, value);
 }
 
-static int
-read_BC_cpu_snb_jkt_ivb_ivt_bdx_hsx(struct BC_cpu_snb_jkt_ivb_ivt_bdx_hsx *reg)
+int read_BC_SMM_BWP(const struct BC *reg, u64 *value)
 {
-	u32 value;
-	const int ret = pci_read_dword(&value, 0x0, 0x1f, 0x5, 0xdc);
+	return read_BC_field(reg, BC_SMM_BWP, value);
+}
+
+int read_SBASE_Base(const struct SBASE *reg, u64 *value)
+{
+	return read_SBASE_field(reg, SBASE_Base, value);
+}
+
+int visit_BC_fields(const struct BC *reg, Register_Field_Visitor *visitor,
+		    void *ctx)
+{
+	return visit_fields(find_descriptor(&reg->register_arch,
+					    BC_pch_descriptors,
+					    BC_cpu_descriptors),
+			    BC_field_names, reg->raw, BC_Fields_count,
+			    visitor, ctx);
+}
+
+int visit_SBASE_fields(const struct SBASE *reg, Register_Field_Visitor *visitor,
+		       void *ctx)
+{
+	return visit_fields(find_descriptor(&reg->register_arch, NULL,
+					    SBASE_cpu_descriptors),
+			    SBASE_field_names, reg->raw, SBASE_Fields_count,
+			    visitor, ctx);
+}
+
+/* Where the SPI controller registers live inside the SPIBAR window */
+struct SPIFieldDescriptor {
+	u16 offset;
+	u8 start;
+	u8 size;
+};
+
+struct SPI_Layout {
+	u16 freg0; /* offset of the first flash region register */
+	u8 region_count;
+	u16 pr0; /* offset of the first protected range register */
+	u8 protected_range_count;
+	u8 fcycle_size; /* width of HSFC.FCYCLE */
+	u8 master_count; /* FLMSTR registers in the descriptor */
+	u8 flmstr_read; /* first read access bit in FLMSTR */
+	u8 flmstr_write; /* first write access bit in FLMSTR */
+	u16 fdoc; /* offset of the flash descriptor observability control */
+	u16 fdod; /* offset of the flash descriptor observability data */
+	struct SPIFieldDescriptor fields[SPI_Fields_count];
+};
+
+#define SPI_FIELD(Offset, Start, Size)                                         \
+	{                                                                      \
+		.offset = (Offset), .start = (Start), .size = (Size)           \
+	}
+#define SPI_COMMON_FIELDS                                                      \
+	[SPI_HSFS_FDOPSS] = SPI_FIELD(0x04, 13, 1),                            \
+	[SPI_HSFS_FDV] = SPI_FIELD(0x04, 14, 1),                               \
+	[SPI_HSFS_FLOCKDN] = SPI_FIELD(0x04, 15, 1),                           \
+	[SPI_FRAP_BRRA] = SPI_FIELD(0x50, 0, 8),                               \
+	[SPI_FRAP_BRWA] = SPI_FIELD(0x50, 8, 8),                               \
+	[SPI_FRAP_BMRAG] = SPI_FIELD(0x50, 16, 8),                             \
+	[SPI_FRAP_BMWAG] = SPI_FIELD(0x50, 24, 8)
+
+/* ICH-style controller of the Atom SoCs */
+static const struct SPI_Layout SPI_atom_avn_byt = {
+	.freg0 = 0x54,
+	.region_count = 5,
+	.pr0 = 0x74,
+	.protected_range_count = 5,
+	.fcycle_size = 2,
+	.master_count = 3,
+	.flmstr_read = 16,
+	.flmstr_write = 24,
+	.fdoc = 0xb0,
+	.fdod = 0xb4,
+	.fields = { SPI_COMMON_FIELDS },
+};
+
+/* Controller of PCH 1xx and later, with more regions */
+static const struct SPI_Layout SPI_pch_1xx_and_later = {
+	.freg0 = 0x54,
+	.region_count = 10,
+	.pr0 = 0x84,
+	.protected_range_count = 5,
+	.fcycle_size = 4,
+	.master_count = 5,
+	.flmstr_read = 8,
+	.flmstr_write = 20,
+	.fdoc = 0xb4,
+	.fdod = 0xb8,
+	.fields = { SPI_COMMON_FIELDS },
+};
+
+#undef SPI_FIELD
+#undef SPI_COMMON_FIELDS
+
+static const struct SPI_Layout *const SPI_pch_layouts[PCH_Archs_count] = {
+	[pch_1xx] = &SPI_pch_1xx_and_later,
+	[pch_c620] = &SPI_pch_1xx_and_later,
+	[pch_2xx] = &SPI_pch_1xx_and_later,
+	[pch_3xx] = &SPI_pch_1xx_and_later,
+	[pch_4xx] = &SPI_pch_1xx_and_later,
+	[pch_495] = &SPI_pch_1xx_and_later,
+	[pch_5xx] = &SPI_pch_1xx_and_later,
+};
+
+static const struct SPI_Layout *const SPI_cpu_layouts[CPU_Archs_count] = {
+	[cpu_avn] = &SPI_atom_avn_byt,
+	[cpu_byt] = &SPI_atom_avn_byt,
+	[cpu_apl] = &SPI_pch_1xx_and_later,
+	[cpu_glk] = &SPI_pch_1xx_and_later,
+};
+
+static const char *const SPI_field_names[SPI_Fields_count] = {
+	[SPI_HSFS_FDOPSS] = "SPI_HSFS_FDOPSS",
+	[SPI_HSFS_FDV] = "SPI_HSFS_FDV",
+	[SPI_HSFS_FLOCKDN] = "SPI_HSFS_FLOCKDN",
+	[SPI_FRAP_BRRA] = "SPI_FRAP_BRRA",
+	[SPI_FRAP_BRWA] = "SPI_FRAP_BRWA",
+	[SPI_FRAP_BMRAG] = "SPI_FRAP_BMRAG",
+	[SPI_FRAP_BMWAG] = "SPI_FRAP_BMWAG",
+};
+
+static const struct SPI_Layout *
+find_SPI_layout(const struct RegisterArch *register_arch)
+{
+	switch (register_arch->source) {
+	case RegSource_PCH:
+		return register_arch->pch_arch < PCH_Archs_count ?
+			       SPI_pch_layouts[register_arch->pch_arch] :
+			       NULL;
+	case RegSource_CPU:
+		return register_arch->cpu_arch < CPU_Archs_count ?
+			       SPI_cpu_layouts[register_arch->cpu_arch] :
+			       NULL;
+	default:
+		return NULL; /* should not reach here, it's a bug */
+	}
+}
+
+static u32 SPI_reg(const struct SPI_Regs *regs, u16 offset)
+{
+	return regs->raw[offset / sizeof(u32)];
+}
 
+static const struct SPI_Layout *
+select_SPI_layout(enum PCH_Arch pch_arch, enum CPU_Arch cpu_arch,
+		  struct RegisterArch *register_arch)
+{
+	/* same precedence as the SPIBAR resolution */
+	register_arch->source = RegSource_CPU;
+	register_arch->cpu_arch = cpu_arch;
+	if (find_SPI_layout(register_arch) == NULL) {
+		register_arch->source = RegSource_PCH;
+		register_arch->pch_arch = pch_arch;
+	}
+	return find_SPI_layout(register_arch);
+}
+
+int read_SPI_regs(enum PCH_Arch pch_arch, enum CPU_Arch cpu_arch,
+		  struct SPI_Regs *regs)
+{
+	u64 barOffset;
+	int ret;
+
+	memset(regs, 0, sizeof(*regs));
+
+	if (select_SPI_layout(pch_arch, cpu_arch, &regs->register_arch) ==
+	    NULL)
+		return -EIO;
+
+	ret = read_SPIBAR(pch_arch, cpu_arch, &barOffset);
 	if (ret != 0)
 		return ret;
 
-	reg->BIOSWE = extract_bits_shifted(u32, value, 0, 1);
-	reg->BLE = extract_bits_shifted(u32, value, 1, 1);
-	reg->SRC = extract_bits_shifted(u32, value, 2, 2);
-	reg->TSS = extract_bits_shifted(u32, value, 4, 1);
-	reg->SMM_BWP = extract_bits_shifted(u32, value, 5, 1);
+	/* one pass over the window, everything else decodes from memory */
+	return mmio_read_block(barOffset, regs->raw, sizeof(regs->raw));
+}
+
+int read_SPI_field(const struct SPI_Regs *regs, enum SPI_Field field,
+		   u64 *value)
+{
+	const struct SPI_Layout *layout = find_SPI_layout(&regs->register_arch);
+	const struct SPIFieldDescriptor *desc;
+
+	*value = 0;
+	if (layout == NULL || field < 0 || field >= SPI_Fields_count)
+		return -EIO;
 
+	desc = &layout->fields[field];
+	if (desc->size == 0)
+		return -EIO; /* requested arch hasn't this field */
+
+	*value = extract_bits_shifted(u32, SPI_reg(regs, desc->offset),
+				      desc->start, desc->size);
 	return 0;
 }
 
-static int read_BC_cpu_skl_kbl_cfl(struct BC_cpu_skl_kbl_cfl *reg)
+unsigned int SPI_region_count(const struct SPI_Regs *regs)
+{
+	const struct SPI_Layout *layout = find_SPI_layout(&regs->register_arch);
+
+	return layout != NULL ? layout->region_count : 0;
+}
+
+unsigned int SPI_fcycle_size(const struct SPI_Regs *regs)
+{
+	const struct SPI_Layout *layout = find_SPI_layout(&regs->register_arch);
+
+	return layout != NULL ? layout->fcycle_size : 0;
+}
+
+/* FREG and FLREG share the layout, in 4KiB units */
+static int decode_SPI_region(u32 value, struct SPI_Region *region)
 {
+	region->base = extract_bits_shifted(u32, value, 0, 15) << 12;
+	region->limit = extract_bits_shifted(u32, value, 16, 15) << 12 | 0xfff;
+
+	return region->base <= region->limit ? 0 : -ENOENT;
+}
+
+/* Returns -ENOENT for a region that isn't used */
+int read_SPI_region(const struct SPI_Regs *regs, unsigned int index,
+		    struct SPI_Region *region)
+{
+	const struct SPI_Layout *layout = find_SPI_layout(&regs->register_arch);
 	u32 value;
-	const int ret = pci_read_dword(&value, 0x0, 0x1f, 0x5, 0xdc);
 
-	if (ret != 0)
-		return ret;
+	if (layout == NULL || index >= layout->region_count)
+		return -EINVAL;
 
-	reg->BIOSWE = extract_bits_shifted(u32, value, 0, 1);
-	reg->BLE = extract_bits_shifted(u32, value, 1, 1);
-	reg->SRC = extract_bits_shifted(u32, value, 2, 2);
-	reg->TSS = extract_bits_shifted(u32, value, 4, 1);
-	reg->SMM_BWP = extract_bits_shifted(u32, value, 5, 1);
-	reg->BBS = extract_bits_shifted(u32, value, 6, 1);
-	reg->BILD = extract_bits_shifted(u32, value, 7, 1);
+	value = SPI_reg(regs, layout->freg0 + index * sizeof(u32));
+	return decode_SPI_region(value, region);
+}
 
-	return 0;
+unsigned int SPI_protected_range_count(const struct SPI_Regs *regs)
+{
+	const struct SPI_Layout *layout = find_SPI_layout(&regs->register_arch);
+
+	return layout != NULL ? layout->protected_range_count : 0;
 }
 
-static int read_BC_cpu_apl_glk(struct BC_cpu_apl_glk *reg)
+/* Returns -ENOENT for a range that protects nothing */
+int read_SPI_protected_range(const struct SPI_Regs *regs, unsigned int index,
+			     struct SPI_ProtectedRange *range)
 {
+	const struct SPI_Layout *layout = find_SPI_layout(&regs->register_arch);
 	u32 value;
-	const int ret = pci_read_dword(&value, 0x0, 0xd, 0x2, 0xdc);
 
-	if (ret != 0)
-		return ret;
+	if (layout == NULL || index >= layout->protected_range_count)
+		return -EINVAL;
+
+	value = SPI_reg(regs, layout->pr0 + index * sizeof(u32));
+	range->base = extract_bits_shifted(u32, value, 0, 15) << 12;
+	range->limit = extract_bits_shifted(u32, value, 16, 15) << 12 | 0xfff;
+	range->read_protected = extract_bits_shifted(u32, value, 15, 1);
+	range->write_protected = extract_bits_shifted(u32, value, 31, 1);
+
+	if (!range->read_protected && !range->write_protected)
+		return -ENOENT;
+	return range->base <= range->limit ? 0 : -ENOENT;
+}
+
+int visit_SPI_fields(const struct SPI_Regs *regs,
+		     Register_Field_Visitor *visitor, void *ctx)
+{
+	struct SPI_Region region;
+	struct SPI_ProtectedRange range;
+	char name[32];
+	unsigned int i;
+	u64 value;
+	int field = SPI_Fields_count;
+
+	if (find_SPI_layout(&regs->register_arch) == NULL)
+		return -EIO;
+
+	for (i = 0; i < SPI_Fields_count; i++) {
+		if (read_SPI_field(regs, i, &value) == 0)
+			visitor(ctx, i, SPI_field_names[i], value);
+	}
 
-	reg->BIOSWE = extract_bits_shifted(u32, value, 0, 1);
-	reg->BLE = extract_bits_shifted(u32, value, 1, 1);
-	reg->SRC = extract_bits_shifted(u32, value, 2, 2);
-	reg->TSS = extract_bits_shifted(u32, value, 4, 1);
-	reg->SMM_BWP = extract_bits_shifted(u32, value, 5, 1);
-	reg->BBS = extract_bits_shifted(u32, value, 6, 1);
-	reg->BILD = extract_bits_shifted(u32, value, 7, 1);
-	reg->SPI_SYNC_SS = extract_bits_shifted(u32, value, 8, 1);
-	reg->OSFH = extract_bits_shifted(u32, value, 9, 1);
-	reg->SPI_ASYNC_SS = extract_bits_shifted(u32, value, 10, 1);
-	reg->ASE_BWP = extract_bits_shifted(u32, value, 11, 1);
+	/* regions and ranges are numbered after the fixed fields */
+	for (i = 0; i < SPI_region_count(regs); i++) {
+		if (read_SPI_region(regs, i, &region) != 0)
+			continue;
+		snprintf(name, sizeof(name), "SPI_FREG%u_Base", i);
+		visitor(ctx, field++, name, region.base);
+		snprintf(name, sizeof(name), "SPI_FREG%u_Limit", i);
+		visitor(ctx, field++, name, region.limit);
+	}
+	for (i = 0; i < SPI_protected_range_count(regs); i++) {
+		if (read_SPI_protected_range(regs, i, &range) != 0)
+			continue;
+		snprintf(name, sizeof(name), "SPI_PR%u_Base", i);
+		visitor(ctx, field++, name, range.base);
+		snprintf(name, sizeof(name), "SPI_PR%u_Limit", i);
+		visitor(ctx, field++, name, range.limit);
+		snprintf(name, sizeof(name), "SPI_PR%u_RPE", i);
+		visitor(ctx, field++, name, range.read_protected);
+		snprintf(name, sizeof(name), "SPI_PR%u_WPE", i);
+		visitor(ctx, field++, name, range.write_protected);
+	}
 
 	return 0;
 }
 
-static int read_BC_cpu_atom_avn(struct BC_cpu_atom_avn *reg,
-				enum PCH_Arch pch_arch, enum CPU_Arch cpu_arch)
+#define FDOC_FDSS_SHIFT 12
+#define FDOC_FDSI_SHIFT 2
+#define FLVALSIG 0x0ff0a55a
+
+enum FD_Section {
+	FD_SECTION_MAP = 0,
+	FD_SECTION_REGION = 2,
+	FD_SECTION_MASTER = 3,
+};
+
+static int read_FD_dword(const struct SPI_Layout *layout, u64 spibar,
+			 enum FD_Section section, unsigned int index,
+			 u32 *value)
+{
+	const u32 fdoc = section << FDOC_FDSS_SHIFT | index << FDOC_FDSI_SHIFT;
+
+	if (mmio_write_dword(spibar + layout->fdoc, fdoc) != 0)
+		return -EIO;
+
+	return mmio_read_dword(spibar + layout->fdod, value) != 0 ? -EIO : 0;
+}
+
+/* Reads the descriptor sections through the FDOC/FDOD window */
+int read_SPI_descriptor(enum PCH_Arch pch_arch, enum CPU_Arch cpu_arch,
+			struct SPI_Descriptor *fd)
 {
-	u8 value;
+	const struct SPI_Layout *layout;
+	u64 spibar;
+	unsigned int i;
 	int ret;
-	u64 barOffset;
 
-	ret = read_SPIBAR(pch_arch, cpu_arch, &barOffset);
+	memset(fd, 0, sizeof(*fd));
+
+	layout = select_SPI_layout(pch_arch, cpu_arch, &fd->register_arch);
+	if (layout == NULL)
+		return -EIO;
+
+	ret = read_SPIBAR(pch_arch, cpu_arch, &spibar);
 	if (ret != 0)
 		return ret;
 
-	ret = mmio_read_byte(barOffset + 0xfc, &value);
+	ret = read_FD_dword(layout, spibar, FD_SECTION_MAP, 0, &fd->flvalsig);
 	if (ret != 0)
 		return ret;
+	if (fd->flvalsig != FLVALSIG)
+		return -ENODEV; /* not in descriptor mode */
 
-	reg->BIOSWE = extract_bits_shifted(u8, value, 0, 1);
-	reg->BLE = extract_bits_shifted(u8, value, 1, 1);
-	reg->SRC = extract_bits_shifted(u8, value, 2, 2);
-	reg->TSS = extract_bits_shifted(u8, value, 4, 1);
-	reg->SMM_BWP = extract_bits_shifted(u8, value, 5, 1);
+	ret = read_FD_dword(layout, spibar, FD_SECTION_MAP, 1, &fd->flmap0);
+	if (ret == 0)
+		ret = read_FD_dword(layout, spibar, FD_SECTION_MAP, 2,
+				    &fd->flmap1);
+	if (ret == 0)
+		ret = read_FD_dword(layout, spibar, FD_SECTION_MAP, 3,
+				    &fd->flmap2);
+	for (i = 0; ret == 0 && i < layout->region_count; i++)
+		ret = read_FD_dword(layout, spibar, FD_SECTION_REGION, i,
+				    &fd->flreg[i]);
+	for (i = 0; ret == 0 && i < layout->master_count; i++)
+		ret = read_FD_dword(layout, spibar, FD_SECTION_MASTER, i,
+				    &fd->flmstr[i]);
+
+	return ret;
+}
+
+unsigned int FD_region_count(const struct SPI_Descriptor *fd)
+{
+	const struct SPI_Layout *layout = find_SPI_layout(&fd->register_arch);
+
+	return layout != NULL ? layout->region_count : 0;
+}
+
+unsigned int FD_master_count(const struct SPI_Descriptor *fd)
+{
+	const struct SPI_Layout *layout = find_SPI_layout(&fd->register_arch);
+
+	return layout != NULL ? layout->master_count : 0;
+}
+
+/* Returns -ENOENT for a region that isn't used */
+int read_FD_region(const struct SPI_Descriptor *fd, unsigned int index,
+		   struct SPI_Region *region)
+{
+	if (index >= FD_region_count(fd))
+		return -EINVAL;
+
+	return decode_SPI_region(fd->flreg[index], region);
+}
+
+int read_FD_master_access(const struct SPI_Descriptor *fd,
+			  unsigned int master, unsigned int region,
+			  bool *read, bool *write)
+{
+	const struct SPI_Layout *layout = find_SPI_layout(&fd->register_arch);
+
+	if (layout == NULL || master >= layout->master_count ||
+	    region >= layout->region_count)
+		return -EINVAL;
+
+	*read = fd->flmstr[master] & BIT(layout->flmstr_read + region);
+	*write = fd->flmstr[master] & BIT(layout->flmstr_write + region);
 
 	return 0;
 }
 
-static int read_BC_cpu_atom_byt(struct BC_cpu_atom_byt *reg,
-				enum PCH_Arch pch_arch, enum CPU_Arch cpu_arch)
+void read_FD_map(const struct SPI_Descriptor *fd, struct FD_Map *map)
 {
-	u32 value;
+	map->fcba = extract_bits_shifted(u32, fd->flmap0, 0, 8) << 4;
+	map->components = extract_bits_shifted(u32, fd->flmap0, 8, 2) + 1;
+	map->frba = extract_bits_shifted(u32, fd->flmap0, 16, 8) << 4;
+	map->regions = extract_bits_shifted(u32, fd->flmap0, 24, 3);
+	map->fmba = extract_bits_shifted(u32, fd->flmap1, 0, 8) << 4;
+	map->masters = extract_bits_shifted(u32, fd->flmap1, 8, 3);
+}
+
+static const char *const FD_master_names[FD_MAX_MASTERS] = {
+	"host", "me", "gbe", "master4", "ec",
+};
+
+const char *FD_master_name(unsigned int master)
+{
+	return master < FD_MAX_MASTERS ? FD_master_names[master] : "none";
+}
+
+/* Returns -ENOENT if there's no BIOS region to decode */
+int read_BIOS_window(const struct BC *bc, const struct SPI_Regs *regs,
+		     struct BIOS_Window *window)
+{
+	struct SPI_Region region;
+	u64 bbs;
 	int ret;
-	u64 barOffset;
 
-	ret = read_SPIBAR(pch_arch, cpu_arch, &barOffset);
-	if (ret != 0)
-		return ret;
+	memset(window, 0, sizeof(*window));
 
-	ret = mmio_read_dword(barOffset + 0xfc, &value);
+	ret = read_SPI_region(regs, SPI_REGION_BIOS, &region);
 	if (ret != 0)
 		return ret;
 
-	reg->BIOSWE = extract_bits_shifted(u32, value, 0, 1);
-	reg->BLE = extract_bits_shifted(u32, value, 1, 1);
-	reg->SRC = extract_bits_shifted(u32, value, 2, 2);
-	reg->SMM_BWP = extract_bits_shifted(u32, value, 5, 1);
+	window->size = min_t(u32, region.limit - region.base + 1,
+			     BIOS_WINDOW_MAX_SIZE);
+	window->base = SZ_4G - window->size;
+	window->flash_address = region.limit + 1 - window->size;
+
+	/* archs without BBS can only boot from SPI */
+	window->decoded = read_BC_field(bc, BC_BBS, &bbs) != 0 || bbs == 0;
 
 	return 0;
 }
 
-int read_BC(enum PCH_Arch pch_arch, enum CPU_Arch cpu_arch, struct BC *reg)
+static const char *const SPI_region_names[SPI_MAX_REGIONS] = {
+	"descriptor",	 "bios",		"me",	     "gbe",
+	"platform_data", "device_expansion",	"bios2",     "microcode",
+	"ec",		 "device_expansion2",
+};
+
+/* Master that owns each region by convention, see FLMSTR for actual rights */
+static const char *const SPI_region_owners[SPI_MAX_REGIONS] = {
+	[1] = "host", [2] = "me", [3] = "gbe", [6] = "host", [8] = "ec",
+};
+
+const char *SPI_region_name(int region)
 {
-	int ret = 0;
-	reg->register_arch.source = RegSource_PCH;
-	reg->register_arch.pch_arch = pch_arch;
-	switch (pch_arch) {
-	case pch_3xx:
-	case pch_4xx:
-	case pch_495:
-	case pch_5xx:
-		ret = read_BC_pch_3xx_4xx_5xx(&reg->pch_5xx);
-		break;
-	default:
-		reg->register_arch.source = RegSource_CPU;
-		reg->register_arch.cpu_arch = cpu_arch;
-		switch (cpu_arch) {
-		case cpu_snb:
-		case cpu_jkt:
-		case cpu_ivb:
-		case cpu_ivt:
-		case cpu_bdw:
-		case cpu_bdx:
-		case cpu_hsx:
-		case cpu_hsw:
-			ret = read_BC_cpu_snb_jkt_ivb_ivt_bdx_hsx(
-				&reg->cpu_hsw);
-			break;
-		case cpu_skl:
-		case cpu_kbl:
-		case cpu_cfl:
-			ret = read_BC_cpu_skl_kbl_cfl(&reg->cpu_cfl);
-			break;
-		case cpu_apl:
-		case cpu_glk:
-			ret = read_BC_cpu_apl_glk(&reg->cpu_glk);
-			break;
-		case cpu_avn:
-			ret = read_BC_cpu_atom_avn(&reg->cpu_avn, pch_arch,
-						   cpu_arch);
-			break;
-		case cpu_byt:
-			ret = read_BC_cpu_atom_byt(&reg->cpu_byt, pch_arch,
-						   cpu_arch);
-			break;
-		default:
-			ret = -EIO;
-		}
-	}
-	return ret;
+	if (region < 0 || region >= SPI_MAX_REGIONS)
+		return "none";
+	return SPI_region_names[region];
 }
 
-int read_SPIBAR(enum PCH_Arch pch_arch, enum CPU_Arch cpu_arch, u64 *offset)
+const char *SPI_region_owner(int region)
 {
-	int ret = 0;
-	u64 field_offset;
+	if (region < 0 || region >= SPI_MAX_REGIONS ||
+	    SPI_region_owners[region] == NULL)
+		return "none";
+	return SPI_region_owners[region];
+}
 
-	switch (cpu_arch) {
-	case cpu_avn:
-	case cpu_byt: {
-		struct SBASE reg;
-		ret = read_SBASE(pch_arch, cpu_arch, &reg);
-		if (ret == 0) {
-			ret = read_SBASE_Base(&reg, &field_offset);
-			*offset = field_offset + 0;
-		}
-	} break;
-	default:
-		ret = -EIO;
-	}
+static int cmp_u64(const void *a, const void *b)
+{
+	const u64 *x = a;
+	const u64 *y = b;
 
-	return ret;
+	if (*x == *y)
+		return 0;
+	return *x < *y ? -1 : 1;
 }
 
-int read_BC_BIOSWE(const struct BC *reg, u64 *value)
+static void describe_SPI_interval(const struct SPI_Regs *regs, u64 address,
+				  struct SPI_Interval *interval)
 {
-	int ret = 0;
+	struct SPI_Region region;
+	struct SPI_ProtectedRange range;
+	unsigned int i;
 
-	switch (reg->register_arch.source) {
-	case RegSource_PCH:
-		switch (reg->register_arch.pch_arch) {
-		case pch_3xx:
-			*value = reg->pch_3xx.BIOSWE;
-			break;
-		case pch_4xx:
-			*value = reg->pch_4xx.BIOSWE;
-			break;
-		case pch_495:
-			*value = reg->pch_495.BIOSWE;
-			break;
-		case pch_5xx:
-			*value = reg->pch_5xx.BIOSWE;
+	interval->region = -1;
+	interval->read_protected = false;
+	interval->write_protected = false;
+
+	for (i = 0; i < SPI_region_count(regs); i++) {
+		if (read_SPI_region(regs, i, &region) == 0 &&
+		    address >= region.base && address <= region.limit) {
+			interval->region = i;
 			break;
-		default:
-			/* requested PCH arch hasn't field BIOSWE */
-			ret = -EIO;
-			*value = 0;
 		}
-		break;
-	case RegSource_CPU:
-		switch (reg->register_arch.cpu_arch) {
-		case cpu_snb:
-			*value = reg->cpu_snb.BIOSWE;
-			break;
-		case cpu_jkt:
-			*value = reg->cpu_jkt.BIOSWE;
-			break;
-		case cpu_ivb:
-			*value = reg->cpu_ivb.BIOSWE;
-			break;
-		case cpu_ivt:
-			*value = reg->cpu_ivt.BIOSWE;
-			break;
-		case cpu_bdw:
-			*value = reg->cpu_bdw.BIOSWE;
-			break;
-		case cpu_bdx:
-			*value = reg->cpu_bdx.BIOSWE;
-			break;
-		case cpu_hsx:
-			*value = reg->cpu_hsx.BIOSWE;
-			break;
-		case cpu_hsw:
-			*value = reg->cpu_hsw.BIOSWE;
-			break;
-		case cpu_skl:
-			*value = reg->cpu_skl.BIOSWE;
-			break;
-		case cpu_kbl:
-			*value = reg->cpu_kbl.BIOSWE;
-			break;
-		case cpu_cfl:
-			*value = reg->cpu_cfl.BIOSWE;
-			break;
-		case cpu_apl:
-			*value = reg->cpu_apl.BIOSWE;
-			break;
-		case cpu_glk:
-			*value = reg->cpu_glk.BIOSWE;
-			break;
-		case cpu_avn:
-			*value = reg->cpu_avn.BIOSWE;
-			break;
-		case cpu_byt:
-			*value = reg->cpu_byt.BIOSWE;
-			break;
-		default:
-			/* requested CPU arch hasn't field BIOSWE */
-			ret = -EIO;
-			*value = 0;
+	}
+	for (i = 0; i < SPI_protected_range_count(regs); i++) {
+		if (read_SPI_protected_range(regs, i, &range) == 0 &&
+		    address >= range.base && address <= range.limit) {
+			interval->read_protected |= range.read_protected;
+			interval->write_protected |= range.write_protected;
 		}
-		break;
-	default:
-		ret = -EIO; /* should not reach here, it's a bug */
-		*value = 0;
 	}
-	return ret;
 }
 
-int read_BC_BLE(const struct BC *reg, u64 *value)
+static bool same_SPI_protection(const struct SPI_Interval *a,
+				const struct SPI_Interval *b)
 {
-	int ret = 0;
+	return a->region == b->region &&
+	       a->read_protected == b->read_protected &&
+	       a->write_protected == b->write_protected;
+}
 
-	switch (reg->register_arch.source) {
-	case RegSource_PCH:
-		switch (reg->register_arch.pch_arch) {
-		case pch_3xx:
-			*value = reg->pch_3xx.BLE;
-			break;
-		case pch_4xx:
-			*value = reg->pch_4xx.BLE;
-			break;
-		case pch_495:
-			*value = reg->pch_495.BLE;
-			break;
-		case pch_5xx:
-			*value = reg->pch_5xx.BLE;
-			break;
-		default:
-			/* requested PCH arch hasn't field BLE */
-			ret = -EIO;
-			*value = 0;
-		}
-		break;
-	case RegSource_CPU:
-		switch (reg->register_arch.cpu_arch) {
-		case cpu_snb:
-			*value = reg->cpu_snb.BLE;
-			break;
-		case cpu_jkt:
-			*value = reg->cpu_jkt.BLE;
-			break;
-		case cpu_ivb:
-			*value = reg->cpu_ivb.BLE;
-			break;
-		case cpu_ivt:
-			*value = reg->cpu_ivt.BLE;
-			break;
-		case cpu_bdw:
-			*value = reg->cpu_bdw.BLE;
-			break;
-		case cpu_bdx:
-			*value = reg->cpu_bdx.BLE;
-			break;
-		case cpu_hsx:
-			*value = reg->cpu_hsx.BLE;
-			break;
-		case cpu_hsw:
-			*value = reg->cpu_hsw.BLE;
-			break;
-		case cpu_skl:
-			*value = reg->cpu_skl.BLE;
-			break;
-		case cpu_kbl:
-			*value = reg->cpu_kbl.BLE;
-			break;
-		case cpu_cfl:
-			*value = reg->cpu_cfl.BLE;
-			break;
-		case cpu_apl:
-			*value = reg->cpu_apl.BLE;
-			break;
-		case cpu_glk:
-			*value = reg->cpu_glk.BLE;
-			break;
-		case cpu_avn:
-			*value = reg->cpu_avn.BLE;
-			break;
-		case cpu_byt:
-			*value = reg->cpu_byt.BLE;
-			break;
-		default:
-			/* requested CPU arch hasn't field BLE */
-			ret = -EIO;
-			*value = 0;
+/*
+ * Splits the flash at every region and PR boundary, so each elementary
+ * interval has a single owner and protection, then merges the neighbours
+ * that ended up identical.
+ */
+void build_SPI_protection_index(const struct SPI_Regs *regs,
+				struct SPI_ProtectionIndex *index)
+{
+	u64 bounds[SPI_MAX_INTERVALS + 1];
+	struct SPI_Region region;
+	struct SPI_ProtectedRange range;
+	unsigned int count = 0;
+	unsigned int i;
+
+	index->count = 0;
+
+	for (i = 0; i < SPI_region_count(regs); i++) {
+		if (read_SPI_region(regs, i, &region) != 0)
+			continue;
+		bounds[count++] = region.base;
+		bounds[count++] = (u64)region.limit + 1;
+	}
+	for (i = 0; i < SPI_protected_range_count(regs); i++) {
+		if (read_SPI_protected_range(regs, i, &range) != 0)
+			continue;
+		bounds[count++] = range.base;
+		bounds[count++] = (u64)range.limit + 1;
+	}
+	sort(bounds, count, sizeof(bounds[0]), cmp_u64, NULL);
+
+	for (i = 0; i + 1 < count; i++) {
+		struct SPI_Interval interval;
+		struct SPI_Interval *last;
+
+		if (bounds[i] == bounds[i + 1])
+			continue;
+
+		describe_SPI_interval(regs, bounds[i], &interval);
+		if (interval.region < 0 && !interval.read_protected &&
+		    !interval.write_protected)
+			continue; /* gap between regions */
+		interval.base = bounds[i];
+		interval.limit = bounds[i + 1] - 1;
+
+		last = index->count > 0 ? &index->intervals[index->count - 1] :
+					  NULL;
+		if (last != NULL && last->limit + 1 == interval.base &&
+		    same_SPI_protection(last, &interval)) {
+			last->limit = interval.limit;
+			continue;
 		}
-		break;
-	default:
-		ret = -EIO; /* should not reach here, it's a bug */
-		*value = 0;
+		index->intervals[index->count++] = interval;
 	}
-	return ret;
 }
 
-int read_BC_SMM_BWP(const struct BC *reg, u64 *value)
+static int cmp_SPI_interval(const void *key, const void *elt)
 {
-	int ret = 0;
+	const u32 *address = key;
+	const struct SPI_Interval *interval = elt;
 
-	switch (reg->register_arch.source) {
-	case RegSource_PCH:
-		switch (reg->register_arch.pch_arch) {
-		case pch_3xx:
-			*value = reg->pch_3xx.SMM_BWP;
-			break;
-		case pch_4xx:
-			*value = reg->pch_4xx.SMM_BWP;
-			break;
-		case pch_495:
-			*value = reg->pch_495.SMM_BWP;
-			break;
-		case pch_5xx:
-			*value = reg->pch_5xx.SMM_BWP;
-			break;
-		default:
-			/* requested PCH arch hasn't field SMM_BWP */
-			ret = -EIO;
-			*value = 0;
-		}
-		break;
-	case RegSource_CPU:
-		switch (reg->register_arch.cpu_arch) {
-		case cpu_snb:
-			*value = reg->cpu_snb.SMM_BWP;
-			break;
-		case cpu_jkt:
-			*value = reg->cpu_jkt.SMM_BWP;
-			break;
-		case cpu_ivb:
-			*value = reg->cpu_ivb.SMM_BWP;
-			break;
-		case cpu_ivt:
-			*value = reg->cpu_ivt.SMM_BWP;
-			break;
-		case cpu_bdw:
-			*value = reg->cpu_bdw.SMM_BWP;
-			break;
-		case cpu_bdx:
-			*value = reg->cpu_bdx.SMM_BWP;
-			break;
-		case cpu_hsx:
-			*value = reg->cpu_hsx.SMM_BWP;
-			break;
-		case cpu_hsw:
-			*value = reg->cpu_hsw.SMM_BWP;
-			break;
-		case cpu_skl:
-			*value = reg->cpu_skl.SMM_BWP;
-			break;
-		case cpu_kbl:
-			*value = reg->cpu_kbl.SMM_BWP;
-			break;
-		case cpu_cfl:
-			*value = reg->cpu_cfl.SMM_BWP;
-			break;
-		case cpu_apl:
-			*value = reg->cpu_apl.SMM_BWP;
-			break;
-		case cpu_glk:
-			*value = reg->cpu_glk.SMM_BWP;
-			break;
-		case cpu_avn:
-			*value = reg->cpu_avn.SMM_BWP;
-			break;
-		case cpu_byt:
-			*value = reg->cpu_byt.SMM_BWP;
-			break;
-		default:
-			/* requested CPU arch hasn't field SMM_BWP */
-			ret = -EIO;
-			*value = 0;
-		}
-		break;
-	default:
-		ret = -EIO; /* should not reach here, it's a bug */
-		*value = 0;
-	}
-	return ret;
+	if (*address < interval->base)
+		return -1;
+	if (*address > interval->limit)
+		return 1;
+	return 0;
 }
 
-int read_SBASE_Base(const struct SBASE *reg, u64 *value)
+/* Returns NULL if the address isn't in any region or protected range */
+const struct SPI_Interval *
+lookup_SPI_protection(const struct SPI_ProtectionIndex *index, u32 address)
 {
-	int ret = 0;
+	return bsearch(&address, index->intervals, index->count,
+		       sizeof(index->intervals[0]), cmp_SPI_interval);
+}
 
-	switch (reg->register_arch.source) {
-	case RegSource_PCH:
-		ret = -EIO; /* no PCH archs have this field */
-		*value = 0;
-		break;
-	case RegSource_CPU:
-		switch (reg->register_arch.cpu_arch) {
-		case cpu_avn:
-			*value = reg->cpu_avn.Base;
-			break;
-		case cpu_byt:
-			*value = reg->cpu_byt.Base;
-			break;
-		default:
-			/* requested CPU arch hasn't field Base */
-			ret = -EIO;
-			*value = 0;
-		}
-		break;
-	default:
-		ret = -EIO; /* should not reach here, it's a bug */
-		*value = 0;
+#define VID_INTEL 0x8086
+#define VID_AMD 0x1022
+
+struct DeviceIdRange {
+	u16 vid;
+	u16 did_first;
+	u16 did_last;
+	u8 arch; /* enum PCH_Arch or enum CPU_Arch */
+};
+
+/* Sorted by vid then did_first, ranges must not overlap */
+static const struct DeviceIdRange pch_id_ranges[] = {
+	{ VID_INTEL, 0x0280, 0x029f, pch_4xx },
+	{ VID_INTEL, 0x0680, 0x069f, pch_4xx },
+	{ VID_INTEL, 0x1c44, 0x1c44, pch_6_c200 },
+	{ VID_INTEL, 0x1c46, 0x1c47, pch_6_c200 },
+	{ VID_INTEL, 0x1c49, 0x1c50, pch_6_c200 },
+	{ VID_INTEL, 0x1c52, 0x1c52, pch_6_c200 },
+	{ VID_INTEL, 0x1c54, 0x1c54, pch_6_c200 },
+	{ VID_INTEL, 0x1c56, 0x1c56, pch_6_c200 },
+	{ VID_INTEL, 0x1c5c, 0x1c5c, pch_6_c200 },
+	{ VID_INTEL, 0x1d41, 0x1d41, pch_c60x_x79 },
+	{ VID_INTEL, 0x1e44, 0x1e44, pch_7_c210 },
+	{ VID_INTEL, 0x1e46, 0x1e4a, pch_7_c210 },
+	{ VID_INTEL, 0x1e53, 0x1e53, pch_7_c210 },
+	{ VID_INTEL, 0x1e55, 0x1e59, pch_7_c210 },
+	{ VID_INTEL, 0x1e5d, 0x1e5e, pch_7_c210 },
+	{ VID_INTEL, 0x2310, 0x2310, pch_communications_89xx },
+	{ VID_INTEL, 0x2390, 0x2390, pch_communications_89xx },
+	{ VID_INTEL, 0x3480, 0x349f, pch_495 },
+	{ VID_INTEL, 0x3887, 0x3887, pch_495 },
+	{ VID_INTEL, 0x4380, 0x439f, pch_5xx },
+	{ VID_INTEL, 0x8c41, 0x8c42, pch_8_c220 },
+	{ VID_INTEL, 0x8c44, 0x8c44, pch_8_c220 },
+	{ VID_INTEL, 0x8c46, 0x8c46, pch_8_c220 },
+	{ VID_INTEL, 0x8c49, 0x8c4c, pch_8_c220 },
+	{ VID_INTEL, 0x8c4e, 0x8c50, pch_8_c220 },
+	{ VID_INTEL, 0x8c52, 0x8c52, pch_8_c220 },
+	{ VID_INTEL, 0x8c54, 0x8c54, pch_8_c220 },
+	{ VID_INTEL, 0x8c56, 0x8c56, pch_8_c220 },
+	{ VID_INTEL, 0x8c5c, 0x8c5c, pch_8_c220 },
+	{ VID_INTEL, 0x8cc1, 0x8cc4, pch_8_c220 },
+	{ VID_INTEL, 0x8cc6, 0x8cc6, pch_8_c220 },
+	{ VID_INTEL, 0x8d40, 0x8d40, pch_c61x_x99 },
+	{ VID_INTEL, 0x8d44, 0x8d44, pch_c61x_x99 },
+	{ VID_INTEL, 0x8d47, 0x8d47, pch_c61x_x99 },
+	{ VID_INTEL, 0x9cc1, 0x9cc3, pch_5_mobile },
+	{ VID_INTEL, 0x9cc5, 0x9cc7, pch_5_mobile },
+	{ VID_INTEL, 0x9cc9, 0x9cc9, pch_5_mobile },
+	{ VID_INTEL, 0x9d41, 0x9d41, pch_6_mobile },
+	{ VID_INTEL, 0x9d43, 0x9d43, pch_6_mobile },
+	{ VID_INTEL, 0x9d46, 0x9d46, pch_6_mobile },
+	{ VID_INTEL, 0x9d48, 0x9d48, pch_6_mobile },
+	{ VID_INTEL, 0x9d4b, 0x9d4b, pch_7_8_mobile },
+	{ VID_INTEL, 0x9d4e, 0x9d4e, pch_7_8_mobile },
+	{ VID_INTEL, 0x9d50, 0x9d50, pch_7_8_mobile },
+	{ VID_INTEL, 0x9d53, 0x9d53, pch_7_8_mobile },
+	{ VID_INTEL, 0x9d56, 0x9d56, pch_7_8_mobile },
+	{ VID_INTEL, 0x9d58, 0x9d58, pch_7_8_mobile },
+	{ VID_INTEL, 0x9d81, 0x9d81, pch_3xx },
+	{ VID_INTEL, 0x9d83, 0x9d86, pch_3xx },
+	{ VID_INTEL, 0xa080, 0xa09f, pch_5xx },
+	{ VID_INTEL, 0xa141, 0xa15f, pch_1xx },
+	{ VID_INTEL, 0xa1c1, 0xa1c7, pch_c620 },
+	{ VID_INTEL, 0xa242, 0xa246, pch_c620 },
+	{ VID_INTEL, 0xa2c0, 0xa2cf, pch_2xx },
+	{ VID_INTEL, 0xa2d2, 0xa2d3, pch_2xx },
+	{ VID_INTEL, 0xa300, 0xa31f, pch_3xx },
+	{ VID_INTEL, 0xa3c1, 0xa3c1, pch_4xx },
+	{ VID_INTEL, 0xa3c8, 0xa3c8, pch_4xx },
+	{ VID_INTEL, 0xa3da, 0xa3da, pch_4xx },
+};
+
+static const struct DeviceIdRange cpu_id_ranges[] = {
+	{ VID_AMD, 0x1410, 0x1410, cpu_amd },
+	{ VID_AMD, 0x1422, 0x1422, cpu_amd },
+	{ VID_AMD, 0x1450, 0x1450, cpu_amd },
+	{ VID_AMD, 0x1480, 0x1480, cpu_amd },
+	{ VID_AMD, 0x1510, 0x1510, cpu_amd },
+	{ VID_AMD, 0x1514, 0x1514, cpu_amd },
+	{ VID_AMD, 0x1536, 0x1536, cpu_amd },
+	{ VID_AMD, 0x1566, 0x1566, cpu_amd },
+	{ VID_AMD, 0x1576, 0x1576, cpu_amd },
+	{ VID_AMD, 0x15d0, 0x15d0, cpu_amd },
+	{ VID_INTEL, 0x0100, 0x0100, cpu_snb },
+	{ VID_INTEL, 0x0104, 0x0104, cpu_snb },
+	{ VID_INTEL, 0x0108, 0x0108, cpu_snb },
+	{ VID_INTEL, 0x0150, 0x0150, cpu_ivb },
+	{ VID_INTEL, 0x0154, 0x0154, cpu_ivb },
+	{ VID_INTEL, 0x0158, 0x0158, cpu_ivb },
+	{ VID_INTEL, 0x0a00, 0x0a00, cpu_hsw },
+	{ VID_INTEL, 0x0a04, 0x0a04, cpu_hsw },
+	{ VID_INTEL, 0x0a08, 0x0a08, cpu_hsw },
+	{ VID_INTEL, 0x0c00, 0x0c00, cpu_hsw },
+	{ VID_INTEL, 0x0c04, 0x0c04, cpu_hsw },
+	{ VID_INTEL, 0x0c08, 0x0c08, cpu_hsw },
+	{ VID_INTEL, 0x0d00, 0x0d00, cpu_hsw },
+	{ VID_INTEL, 0x0d04, 0x0d04, cpu_hsw },
+	{ VID_INTEL, 0x0d08, 0x0d08, cpu_hsw },
+	{ VID_INTEL, 0x0e00, 0x0e00, cpu_ivt },
+	{ VID_INTEL, 0x0f00, 0x0f00, cpu_byt },
+	{ VID_INTEL, 0x1600, 0x1600, cpu_bdw },
+	{ VID_INTEL, 0x1604, 0x1604, cpu_bdw },
+	{ VID_INTEL, 0x1610, 0x1610, cpu_bdw },
+	{ VID_INTEL, 0x1614, 0x1614, cpu_bdw },
+	{ VID_INTEL, 0x1618, 0x1618, cpu_bdw },
+	{ VID_INTEL, 0x1900, 0x1900, cpu_skl },
+	{ VID_INTEL, 0x1904, 0x1904, cpu_skl },
+	{ VID_INTEL, 0x190c, 0x190c, cpu_skl },
+	{ VID_INTEL, 0x190f, 0x1910, cpu_skl },
+	{ VID_INTEL, 0x1918, 0x1918, cpu_skl },
+	{ VID_INTEL, 0x191f, 0x191f, cpu_skl },
+	{ VID_INTEL, 0x1f00, 0x1f0f, cpu_avn },
+	{ VID_INTEL, 0x2020, 0x2020, cpu_skl },
+	{ VID_INTEL, 0x2f00, 0x2f00, cpu_hsx },
+	{ VID_INTEL, 0x3180, 0x3180, cpu_glk },
+	{ VID_INTEL, 0x31f0, 0x31f0, cpu_glk },
+	{ VID_INTEL, 0x3c00, 0x3c00, cpu_jkt },
+	{ VID_INTEL, 0x3e0f, 0x3e10, cpu_cfl },
+	{ VID_INTEL, 0x3e18, 0x3e18, cpu_cfl },
+	{ VID_INTEL, 0x3e1f, 0x3e1f, cpu_cfl },
+	{ VID_INTEL, 0x3e20, 0x3e20, cpu_cml },
+	{ VID_INTEL, 0x3e30, 0x3e33, cpu_cfl },
+	{ VID_INTEL, 0x3e34, 0x3e35, cpu_whl },
+	{ VID_INTEL, 0x3ec2, 0x3ec2, cpu_cfl },
+	{ VID_INTEL, 0x3ec4, 0x3ec4, cpu_cfl },
+	{ VID_INTEL, 0x3ec6, 0x3ec6, cpu_cfl },
+	{ VID_INTEL, 0x3eca, 0x3eca, cpu_cfl },
+	{ VID_INTEL, 0x3ecc, 0x3ecc, cpu_cfl },
+	{ VID_INTEL, 0x3ed0, 0x3ed0, cpu_cfl },
+	{ VID_INTEL, 0x5900, 0x5900, cpu_kbl },
+	{ VID_INTEL, 0x5904, 0x5904, cpu_kbl },
+	{ VID_INTEL, 0x590c, 0x590c, cpu_kbl },
+	{ VID_INTEL, 0x590f, 0x5910, cpu_kbl },
+	{ VID_INTEL, 0x5914, 0x5914, cpu_kbl },
+	{ VID_INTEL, 0x5918, 0x5918, cpu_kbl },
+	{ VID_INTEL, 0x591f, 0x591f, cpu_kbl },
+	{ VID_INTEL, 0x5af0, 0x5af0, cpu_apl },
+	{ VID_INTEL, 0x6f00, 0x6f00, cpu_bdx },
+	{ VID_INTEL, 0x8a00, 0x8a00, cpu_icl },
+	{ VID_INTEL, 0x8a02, 0x8a02, cpu_icl },
+	{ VID_INTEL, 0x8a10, 0x8a10, cpu_icl },
+	{ VID_INTEL, 0x8a12, 0x8a12, cpu_icl },
+	{ VID_INTEL, 0x8a16, 0x8a16, cpu_icl },
+	{ VID_INTEL, 0x9a02, 0x9a02, cpu_tgl },
+	{ VID_INTEL, 0x9a04, 0x9a04, cpu_tgl },
+	{ VID_INTEL, 0x9a12, 0x9a12, cpu_tgl },
+	{ VID_INTEL, 0x9a14, 0x9a14, cpu_tgl },
+	{ VID_INTEL, 0x9a26, 0x9a26, cpu_tgl },
+	{ VID_INTEL, 0x9a36, 0x9a36, cpu_tgl },
+	{ VID_INTEL, 0x9b33, 0x9b33, cpu_cml },
+	{ VID_INTEL, 0x9b43, 0x9b44, cpu_cml },
+	{ VID_INTEL, 0x9b51, 0x9b51, cpu_cml },
+	{ VID_INTEL, 0x9b53, 0x9b54, cpu_cml },
+	{ VID_INTEL, 0x9b61, 0x9b61, cpu_cml },
+	{ VID_INTEL, 0x9b63, 0x9b64, cpu_cml },
+	{ VID_INTEL, 0x9b71, 0x9b71, cpu_cml },
+	{ VID_INTEL, 0x9b73, 0x9b73, cpu_cml },
+};
+
+/*
+ * Mappings added at runtime for silicon newer than the tables above. They are
+ * only modified during detection, which is serialized by the caller.
+ */
+#define MAX_EXTRA_DEVICE_IDS 32
+
+static struct DeviceIdRange extra_pch_id_ranges[MAX_EXTRA_DEVICE_IDS];
+static size_t extra_pch_id_count;
+static struct DeviceIdRange extra_cpu_id_ranges[MAX_EXTRA_DEVICE_IDS];
+static size_t extra_cpu_id_count;
+
+static const char *const pch_arch_names[PCH_Archs_count] = {
+	[pch_none] = "pch_none",
+	[pch_6_c200] = "pch_6_c200",
+	[pch_7_c210] = "pch_7_c210",
+	[pch_c60x_x79] = "pch_c60x_x79",
+	[pch_communications_89xx] = "pch_communications_89xx",
+	[pch_8_c220] = "pch_8_c220",
+	[pch_c61x_x99] = "pch_c61x_x99",
+	[pch_5_mobile] = "pch_5_mobile",
+	[pch_6_mobile] = "pch_6_mobile",
+	[pch_7_8_mobile] = "pch_7_8_mobile",
+	[pch_1xx] = "pch_1xx",
+	[pch_c620] = "pch_c620",
+	[pch_2xx] = "pch_2xx",
+	[pch_3xx] = "pch_3xx",
+	[pch_4xx] = "pch_4xx",
+	[pch_495] = "pch_495",
+	[pch_5xx] = "pch_5xx",
+};
+
+static const char *const cpu_arch_names[CPU_Archs_count] = {
+	[cpu_none] = "cpu_none",
+	[cpu_bdw] = "cpu_bdw",
+	[cpu_bdx] = "cpu_bdx",
+	[cpu_hsw] = "cpu_hsw",
+	[cpu_hsx] = "cpu_hsx",
+	[cpu_ivt] = "cpu_ivt",
+	[cpu_jkt] = "cpu_jkt",
+	[cpu_kbl] = "cpu_kbl",
+	[cpu_skl] = "cpu_skl",
+	[cpu_ivb] = "cpu_ivb",
+	[cpu_snb] = "cpu_snb",
+	[cpu_avn] = "cpu_avn",
+	[cpu_cfl] = "cpu_cfl",
+	[cpu_byt] = "cpu_byt",
+	[cpu_whl] = "cpu_whl",
+	[cpu_cml] = "cpu_cml",
+	[cpu_icl] = "cpu_icl",
+	[cpu_apl] = "cpu_apl",
+	[cpu_glk] = "cpu_glk",
+	[cpu_tgl] = "cpu_tgl",
+	[cpu_amd] = "cpu_amd",
+};
+
+struct DeviceId {
+	u16 vid;
+	u16 did;
+};
+
+static int cmp_device_id_range(const void *key, const void *elt)
+{
+	const struct DeviceId *id = key;
+	const struct DeviceIdRange *range = elt;
+
+	if (id->vid != range->vid)
+		return id->vid < range->vid ? -1 : 1;
+	if (id->did < range->did_first)
+		return -1;
+	if (id->did > range->did_last)
+		return 1;
+	return 0;
+}
+
+static int viddid2arch(const struct DeviceIdRange *ranges, size_t count,
+		       const struct DeviceIdRange *extra_ranges,
+		       size_t extra_count, u64 vid, u64 did, u8 *arch)
+{
+	const struct DeviceIdRange *range;
+	const struct DeviceId id = { .vid = vid, .did = did };
+	size_t i;
+
+	if (vid > U16_MAX || did > U16_MAX)
+		return -EIO;
+
+	range = bsearch(&id, ranges, count, sizeof(*ranges),
+			cmp_device_id_range);
+	for (i = 0; range == NULL && i < extra_count; i++) {
+		if (cmp_device_id_range(&id, &extra_ranges[i]) == 0)
+			range = &extra_ranges[i];
 	}
-	return ret;
+	if (range == NULL)
+		return -EIO; /* VID/DID not found */
+
+	*arch = range->arch;
+	return 0;
 }
 
 int viddid2pch_arch(u64 vid, u64 did, enum PCH_Arch *arch)
 {
-	switch (vid) {
-	case 0x8086: /* INTEL */
-		switch (did) {
-		case 0x1c44:
-		case 0x1c46:
-		case 0x1c47:
-		case 0x1c49:
-		case 0x1c4a:
-		case 0x1c4b:
-		case 0x1c4c:
-		case 0x1c4d:
-		case 0x1c4e:
-		case 0x1c4f:
-		case 0x1c50:
-		case 0x1c52:
-		case 0x1c54:
-		case 0x1c56:
-		case 0x1c5c:
-			*arch = pch_6_c200;
-			return 0;
-		case 0x1e47:
-		case 0x1e48:
-		case 0x1e49:
-		case 0x1e44:
-		case 0x1e46:
-		case 0x1e4a:
-		case 0x1e53:
-		case 0x1e55:
-		case 0x1e58:
-		case 0x1e57:
-		case 0x1e59:
-		case 0x1e5d:
-		case 0x1e5e:
-		case 0x1e56:
-			*arch = pch_7_c210;
-			return 0;
-		case 0x1d41:
-			*arch = pch_c60x_x79;
-			return 0;
-		case 0x2390:
-		case 0x2310:
-			*arch = pch_communications_89xx;
-			return 0;
-		case 0x8c41:
-		case 0x8c42:
-		case 0x8c44:
-		case 0x8c46:
-		case 0x8c49:
-		case 0x8c4a:
-		case 0x8c4b:
-		case 0x8c4c:
-		case 0x8c4e:
-		case 0x8c4f:
-		case 0x8c50:
-		case 0x8c52:
-		case 0x8c54:
-		case 0x8c56:
-		case 0x8c5c:
-		case 0x8cc1:
-		case 0x8cc2:
-		case 0x8cc3:
-		case 0x8cc4:
-		case 0x8cc6:
-			*arch = pch_8_c220;
-			return 0;
-		case 0x8d40:
-		case 0x8d44:
-		case 0x8d47:
-			*arch = pch_c61x_x99;
-			return 0;
-		case 0x9cc3:
-		case 0x9cc5:
-		case 0x9cc7:
-		case 0x9cc9:
-		case 0x9cc1:
-		case 0x9cc2:
-		case 0x9cc6:
-			*arch = pch_5_mobile;
-			return 0;
-		case 0x9d41:
-		case 0x9d43:
-		case 0x9d46:
-		case 0x9d48:
-			*arch = pch_6_mobile;
-			return 0;
-		case 0x9d4b:
-		case 0x9d4e:
-		case 0x9d50:
-		case 0x9d53:
-		case 0x9d56:
-		case 0x9d58:
-			*arch = pch_7_8_mobile;
-			return 0;
-		case 0xa141:
-		case 0xa142:
-		case 0xa143:
-		case 0xa144:
-		case 0xa145:
-		case 0xa146:
-		case 0xa147:
-		case 0xa148:
-		case 0xa149:
-		case 0xa14a:
-		case 0xa14b:
-		case 0xa14c:
-		case 0xa14d:
-		case 0xa14e:
-		case 0xa14f:
-		case 0xa150:
-		case 0xa151:
-		case 0xa152:
-		case 0xa153:
-		case 0xa154:
-		case 0xa155:
-		case 0xa156:
-		case 0xa157:
-		case 0xa158:
-		case 0xa159:
-		case 0xa15a:
-		case 0xa15b:
-		case 0xa15c:
-		case 0xa15d:
-		case 0xa15e:
-		case 0xa15f:
-			*arch = pch_1xx;
-			return 0;
-		case 0xa1c1:
-		case 0xa1c2:
-		case 0xa1c3:
-		case 0xa1c4:
-		case 0xa1c5:
-		case 0xa1c6:
-		case 0xa1c7:
-		case 0xa242:
-		case 0xa243:
-		case 0xa244:
-		case 0xa245:
-		case 0xa246:
-			*arch = pch_c620;
-			return 0;
-		case 0xa2c0:
-		case 0xa2c1:
-		case 0xa2c2:
-		case 0xa2c3:
-		case 0xa2c4:
-		case 0xa2c5:
-		case 0xa2c6:
-		case 0xa2c7:
-		case 0xa2c8:
-		case 0xa2c9:
-		case 0xa2ca:
-		case 0xa2cb:
-		case 0xa2cc:
-		case 0xa2cd:
-		case 0xa2ce:
-		case 0xa2cf:
-		case 0xa2d2:
-		case 0xa2d3:
-			*arch = pch_2xx;
-			return 0;
-		case 0xa300:
-		case 0xa301:
-		case 0xa302:
-		case 0xa303:
-		case 0xa304:
-		case 0xa305:
-		case 0xa306:
-		case 0xa307:
-		case 0xa308:
-		case 0xa309:
-		case 0xa30a:
-		case 0xa30b:
-		case 0xa30c:
-		case 0xa30d:
-		case 0xa30e:
-		case 0xa30f:
-		case 0xa310:
-		case 0xa311:
-		case 0xa312:
-		case 0xa313:
-		case 0xa314:
-		case 0xa315:
-		case 0xa316:
-		case 0xa317:
-		case 0xa318:
-		case 0xa319:
-		case 0xa31a:
-		case 0xa31b:
-		case 0xa31c:
-		case 0xa31d:
-		case 0xa31e:
-		case 0xa31f:
-		case 0x9d81:
-		case 0x9d83:
-		case 0x9d84:
-		case 0x9d85:
-		case 0x9d86:
-			*arch = pch_3xx;
-			return 0;
-		case 0x280:
-		case 0x281:
-		case 0x282:
-		case 0x283:
-		case 0x284:
-		case 0x285:
-		case 0x286:
-		case 0x287:
-		case 0x288:
-		case 0x289:
-		case 0x28a:
-		case 0x28b:
-		case 0x28c:
-		case 0x28d:
-		case 0x28e:
-		case 0x28f:
-		case 0x290:
-		case 0x291:
-		case 0x292:
-		case 0x293:
-		case 0x294:
-		case 0x295:
-		case 0x296:
-		case 0x297:
-		case 0x298:
-		case 0x299:
-		case 0x29a:
-		case 0x29b:
-		case 0x29c:
-		case 0x29d:
-		case 0x29e:
-		case 0x29f:
-		case 0x680:
-		case 0x681:
-		case 0x682:
-		case 0x683:
-		case 0x684:
-		case 0x685:
-		case 0x686:
-		case 0x687:
-		case 0x688:
-		case 0x689:
-		case 0x68a:
-		case 0x68b:
-		case 0x68c:
-		case 0x68d:
-		case 0x68e:
-		case 0x68f:
-		case 0x690:
-		case 0x691:
-		case 0x692:
-		case 0x693:
-		case 0x694:
-		case 0x695:
-		case 0x696:
-		case 0x697:
-		case 0x698:
-		case 0x699:
-		case 0x69a:
-		case 0x69b:
-		case 0x69c:
-		case 0x69d:
-		case 0x69e:
-		case 0x69f:
-		case 0xa3c1:
-		case 0xa3c8:
-		case 0xa3da:
-			*arch = pch_4xx;
-			return 0;
-		case 0x3480:
-		case 0x3481:
-		case 0x3482:
-		case 0x3483:
-		case 0x3484:
-		case 0x3485:
-		case 0x3486:
-		case 0x3487:
-		case 0x3488:
-		case 0x3489:
-		case 0x348a:
-		case 0x348b:
-		case 0x348c:
-		case 0x348d:
-		case 0x348e:
-		case 0x348f:
-		case 0x3490:
-		case 0x3491:
-		case 0x3492:
-		case 0x3493:
-		case 0x3494:
-		case 0x3495:
-		case 0x3496:
-		case 0x3497:
-		case 0x3498:
-		case 0x3499:
-		case 0x349a:
-		case 0x349b:
-		case 0x349c:
-		case 0x349d:
-		case 0x349e:
-		case 0x349f:
-		case 0x3887:
-			*arch = pch_495;
-			return 0;
-		case 0x4380:
-		case 0x4381:
-		case 0x4382:
-		case 0x4383:
-		case 0x4384:
-		case 0x4385:
-		case 0x4386:
-		case 0x4387:
-		case 0x4388:
-		case 0x4389:
-		case 0x438a:
-		case 0x438b:
-		case 0x438c:
-		case 0x438d:
-		case 0x438e:
-		case 0x438f:
-		case 0x4390:
-		case 0x4391:
-		case 0x4392:
-		case 0x4393:
-		case 0x4394:
-		case 0x4395:
-		case 0x4396:
-		case 0x4397:
-		case 0x4398:
-		case 0x4399:
-		case 0x439a:
-		case 0x439b:
-		case 0x439c:
-		case 0x439d:
-		case 0x439e:
-		case 0x439f:
-		case 0xa080:
-		case 0xa081:
-		case 0xa082:
-		case 0xa083:
-		case 0xa084:
-		case 0xa085:
-		case 0xa086:
-		case 0xa087:
-		case 0xa088:
-		case 0xa089:
-		case 0xa08a:
-		case 0xa08b:
-		case 0xa08c:
-		case 0xa08d:
-		case 0xa08e:
-		case 0xa08f:
-		case 0xa090:
-		case 0xa091:
-		case 0xa092:
-		case 0xa093:
-		case 0xa094:
-		case 0xa095:
-		case 0xa096:
-		case 0xa097:
-		case 0xa098:
-		case 0xa099:
-		case 0xa09a:
-		case 0xa09b:
-		case 0xa09c:
-		case 0xa09d:
-		case 0xa09e:
-		case 0xa09f:
-			*arch = pch_5xx;
-			return 0;
-		default:
-			*arch = pch_none;
-			return -EIO; /* DID not found */
-		}
-	case 0x1022: /* AMD */
-		switch (did) {
-		default:
-			*arch = pch_none;
-			return -EIO; /* DID not found */
-		}
-	default:
-		return -EIO; /* VID not supported */
-	}
+	u8 found;
+	int ret = viddid2arch(pch_id_ranges, ARRAY_SIZE(pch_id_ranges),
+			      extra_pch_id_ranges, extra_pch_id_count, vid, did,
+			      &found);
+
+	*arch = ret == 0 ? found : pch_none;
+	return ret;
 }
 
 int viddid2cpu_arch(u64 vid, u64 did, enum CPU_Arch *arch)
 {
-	switch (vid) {
-	case 0x8086: /* INTEL */
-		switch (did) {
-		case 0x1600:
-		case 0x1604:
-		case 0x1610:
-		case 0x1614:
-		case 0x1618:
-			*arch = cpu_bdw;
-			return 0;
-		case 0x6f00:
-			*arch = cpu_bdx;
-			return 0;
-		case 0xa00:
-		case 0xa04:
-		case 0xa08:
-		case 0xc00:
-		case 0xc04:
-		case 0xc08:
-		case 0xd00:
-		case 0xd04:
-		case 0xd08:
-			*arch = cpu_hsw;
-			return 0;
-		case 0x2f00:
-			*arch = cpu_hsx;
-			return 0;
-		case 0xe00:
-			*arch = cpu_ivt;
-			return 0;
-		case 0x3c00:
-			*arch = cpu_jkt;
-			return 0;
-		case 0x5900:
-		case 0x5904:
-		case 0x590c:
-		case 0x590f:
-		case 0x5910:
-		case 0x5914:
-		case 0x5918:
-		case 0x591f:
-			*arch = cpu_kbl;
-			return 0;
-		case 0x1900:
-		case 0x1904:
-		case 0x190c:
-		case 0x190f:
-		case 0x1910:
-		case 0x191f:
-		case 0x1918:
-		case 0x2020:
-			*arch = cpu_skl;
-			return 0;
-		case 0x150:
-		case 0x154:
-		case 0x158:
-			*arch = cpu_ivb;
-			return 0;
-		case 0x100:
-		case 0x104:
-		case 0x108:
-			*arch = cpu_snb;
-			return 0;
-		case 0x1f00:
-		case 0x1f01:
-		case 0x1f02:
-		case 0x1f03:
-		case 0x1f04:
-		case 0x1f05:
-		case 0x1f06:
-		case 0x1f07:
-		case 0x1f08:
-		case 0x1f09:
-		case 0x1f0a:
-		case 0x1f0b:
-		case 0x1f0c:
-		case 0x1f0d:
-		case 0x1f0e:
-		case 0x1f0f:
-			*arch = cpu_avn;
-			return 0;
-		case 0x3e0f:
-		case 0x3e10:
-		case 0x3e18:
-		case 0x3e1f:
-		case 0x3e30:
-		case 0x3e31:
-		case 0x3e32:
-		case 0x3e33:
-		case 0x3ec2:
-		case 0x3ec4:
-		case 0x3ec6:
-		case 0x3eca:
-		case 0x3ecc:
-		case 0x3ed0:
-			*arch = cpu_cfl;
-			return 0;
-		case 0xf00:
-			*arch = cpu_byt;
-			return 0;
-		case 0x3e34:
-		case 0x3e35:
-			*arch = cpu_whl;
-			return 0;
-		case 0x3e20:
-		case 0x9b33:
-		case 0x9b43:
-		case 0x9b44:
-		case 0x9b51:
-		case 0x9b53:
-		case 0x9b54:
-		case 0x9b61:
-		case 0x9b63:
-		case 0x9b64:
-		case 0x9b71:
-		case 0x9b73:
-			*arch = cpu_cml;
-			return 0;
-		case 0x8a00:
-		case 0x8a02:
-		case 0x8a10:
-		case 0x8a12:
-		case 0x8a16:
-			*arch = cpu_icl;
-			return 0;
-		case 0x5af0:
-			*arch = cpu_apl;
-			return 0;
-		case 0x3180:
-		case 0x31f0:
-			*arch = cpu_glk;
-			return 0;
-		case 0x9a02:
-		case 0x9a04:
-		case 0x9a12:
-		case 0x9a14:
-		case 0x9a26:
-		case 0x9a36:
-			*arch = cpu_tgl;
-			return 0;
-		default:
-			*arch = cpu_none;
-			return -EIO; /* DID not found */
-		}
-	case 0x1022: /* AMD */
-		switch (did) {
-		case 0x1410:
-		case 0x1422:
-		case 0x1576:
-		case 0x1510:
-		case 0x1514:
-		case 0x1536:
-		case 0x1566:
-		case 0x1450:
-		case 0x1480:
-		case 0x15d0:
-			*arch = cpu_amd;
-			return 0;
-		default:
-			*arch = cpu_none;
-			return -EIO; /* DID not found */
+	u8 found;
+	int ret = viddid2arch(cpu_id_ranges, ARRAY_SIZE(cpu_id_ranges),
+			      extra_cpu_id_ranges, extra_cpu_id_count, vid, did,
+			      &found);
+
+	*arch = ret == 0 ? found : cpu_none;
+	return ret;
+}
+
+static int add_device_id_range(struct DeviceIdRange *ranges, size_t *count,
+			       u16 vid, u16 did, u8 arch)
+{
+	if (*count >= MAX_EXTRA_DEVICE_IDS)
+		return -ENOSPC;
+
+	ranges[*count].vid = vid;
+	ranges[*count].did_first = did;
+	ranges[*count].did_last = did;
+	ranges[*count].arch = arch;
+	(*count)++;
+	return 0;
+}
+
+/* Parses a vid:did=arch mapping, e.g. 8086:a3a1=pch_5xx */
+static int add_device_id(const char *mapping)
+{
+	char arch_name[32];
+	u16 vid;
+	u16 did;
+	int arch;
+
+	if (sscanf(mapping, "%hx:%hx=%31s", &vid, &did, arch_name) != 3)
+		return -EINVAL;
+
+	arch = match_string(pch_arch_names, PCH_Archs_count, arch_name);
+	if (arch > pch_none)
+		return add_device_id_range(extra_pch_id_ranges,
+					   &extra_pch_id_count, vid, did, arch);
+
+	arch = match_string(cpu_arch_names, CPU_Archs_count, arch_name);
+	if (arch > cpu_none)
+		return add_device_id_range(extra_cpu_id_ranges,
+					   &extra_cpu_id_count, vid, did, arch);
+
+	return -EINVAL;
+}
+
+/* Adds all the mappings or, if one of them is rejected, none of them */
+int add_device_ids(const char *mappings)
+{
+	const size_t pch_count = extra_pch_id_count;
+	const size_t cpu_count = extra_cpu_id_count;
+	char *copy;
+	char *cursor;
+	char *mapping;
+	int ret = 0;
+
+	copy = kstrdup(mappings, GFP_KERNEL);
+	if (copy == NULL)
+		return -ENOMEM;
+
+	cursor = copy;
+	while ((mapping = strsep(&cursor, ",\n")) != NULL) {
+		mapping = strim(mapping);
+		if (*mapping == '\0')
+			continue;
+
+		ret = add_device_id(mapping);
+		if (ret != 0) {
+			pr_err("Invalid device ID mapping '%s'\n", mapping);
+			extra_pch_id_count = pch_count;
+			extra_cpu_id_count = cpu_count;
+			break;
 		}
-	default:
-		return -EIO; /* VID not supported */
 	}
+
+	if (ret == 0)
+		pr_info("Added %zu device ID mappings\n",
+			extra_pch_id_count + extra_cpu_id_count - pch_count -
+				cpu_count);
+	kfree(copy);
+	return ret;
 }
@@ -58,128 +58,195 @@ enum CPU_Arch {
 	CPU_Archs_count
 };
 
+/* Size of the SPI controller register window pointed by SPIBAR */
+#define SPIBAR_SIZE 0x200
+
+enum BC_Field {
+	BC_BIOSWE,
+	BC_BLE,
+	BC_SRC,
+	BC_TSS,
+	BC_SMM_BWP,
+	BC_BBS,
+	BC_BILD,
+	BC_SPI_SYNC_SS,
+	BC_OSFH,
+	BC_SPI_ASYNC_SS,
+	BC_ASE_BWP,
+	BC_Fields_count
+};
+
+enum SBASE_Field {
+	SBASE_MEMI,
+	SBASE_Enable,
+	SBASE_ADDRNG,
+	SBASE_PREF,
+	SBASE_Base,
+	SBASE_Fields_count
+};
+
+enum SPI_Field {
+	SPI_HSFS_FDOPSS,
+	SPI_HSFS_FDV,
+	SPI_HSFS_FLOCKDN,
+	SPI_FRAP_BRRA,
+	SPI_FRAP_BRWA,
+	SPI_FRAP_BMRAG,
+	SPI_FRAP_BMWAG,
+	SPI_Fields_count
+};
+
+/* Called for every field a register has on the detected arch */
+typedef void Register_Field_Visitor(void *ctx, int field, const char *name,
+				    u64 value);
+
 enum RegisterSource { RegSource_PCH, RegSource_CPU };
 
+/* Stored as bytes to keep the registers small enough to snapshot cheaply */
 struct RegisterArch {
-	enum RegisterSource source;
+	u8 source; /* enum RegisterSource */
 
 	union {
-		enum PCH_Arch pch_arch;
-		enum CPU_Arch cpu_arch;
+		u8 pch_arch; /* enum PCH_Arch */
+		u8 cpu_arch; /* enum CPU_Arch */
 	};
 };
 
-struct SBASE_atom_avn_byt {
-	u64 MEMI;
-	u64 Enable;
-	u64 ADDRNG;
-	u64 PREF;
-	u64 Base;
+/* Registers keep the raw value, fields are only extracted when asked for */
+struct SBASE {
+	struct RegisterArch register_arch;
+	u32 raw; /* register value as read from the hardware */
 };
 
-struct SBASE {
+struct BC {
 	struct RegisterArch register_arch;
+	u32 raw; /* register value as read from the hardware */
+};
 
-	union {
-		struct SBASE_atom_avn_byt cpu_avn;
-		struct SBASE_atom_avn_byt cpu_byt;
-	};
+/* Part of the SPIBAR window copied in one pass, up to the last PR register */
+#define SPI_REGS_SIZE 0xa0
+#define SPI_MAX_REGIONS 10
+#define SPI_MAX_PROTECTED_RANGES 5
+
+struct SPI_Regs {
+	struct RegisterArch register_arch;
+	u32 raw[SPI_REGS_SIZE / sizeof(u32)];
 };
 
-struct BC_pch_3xx_4xx_5xx {
-	u64 BIOSWE;
-	u64 BLE;
-	u64 SRC;
-	u64 TSS;
-	u64 SMM_BWP;
-	u64 BBS;
-	u64 BILD;
-	u64 SPI_SYNC_SS;
-	u64 SPI_ASYNC_SS;
-	u64 ASE_BWP;
-};
-
-struct BC_cpu_snb_jkt_ivb_ivt_bdx_hsx {
-	u64 BIOSWE;
-	u64 BLE;
-	u64 SRC;
-	u64 TSS;
-	u64 SMM_BWP;
-};
-
-struct BC_cpu_skl_kbl_cfl {
-	u64 BIOSWE;
-	u64 BLE;
-	u64 SRC;
-	u64 TSS;
-	u64 SMM_BWP;
-	u64 BBS;
-	u64 BILD;
-};
-
-struct BC_cpu_apl_glk {
-	u64 BIOSWE;
-	u64 BLE;
-	u64 SRC;
-	u64 TSS;
-	u64 SMM_BWP;
-	u64 BBS;
-	u64 BILD;
-	u64 SPI_SYNC_SS;
-	u64 OSFH;
-	u64 SPI_ASYNC_SS;
-	u64 ASE_BWP;
-};
-
-struct BC_cpu_atom_avn {
-	u64 BIOSWE;
-	u64 BLE;
-	u64 SRC;
-	u64 TSS;
-	u64 SMM_BWP;
-};
-
-struct BC_cpu_atom_byt {
-	u64 BIOSWE;
-	u64 BLE;
-	u64 SRC;
-	u64 SMM_BWP;
+/* Flash linear addresses, limit is inclusive */
+struct SPI_Region {
+	u32 base;
+	u32 limit;
 };
 
-struct BC {
+struct SPI_ProtectedRange {
+	u32 base;
+	u32 limit;
+	bool read_protected;
+	bool write_protected;
+};
+
+#define SPI_REGION_BIOS 1
+#define BIOS_WINDOW_MAX_SIZE 0x1000000 /* decoded below 4 GiB, at most */
+
+/* Top of the BIOS region, as the chipset decodes it ending at 4 GiB */
+struct BIOS_Window {
+	u64 base; /* physical address */
+	u32 size;
+	u32 flash_address; /* flash linear address of the first byte */
+	bool decoded; /* false if the chipset boots from LPC instead */
+};
+
+#define FD_MAX_MASTERS 5
+
+/* Flash descriptor sections, read through FDOC/FDOD */
+struct SPI_Descriptor {
 	struct RegisterArch register_arch;
+	u32 flvalsig;
+	u32 flmap0;
+	u32 flmap1;
+	u32 flmap2;
+	u32 flreg[SPI_MAX_REGIONS];
+	u32 flmstr[FD_MAX_MASTERS]; /* FLMSTR1 first */
+};
 
-	union {
-		struct BC_pch_3xx_4xx_5xx pch_3xx;
-		struct BC_pch_3xx_4xx_5xx pch_4xx;
-		struct BC_pch_3xx_4xx_5xx pch_495;
-		struct BC_pch_3xx_4xx_5xx pch_5xx;
-		struct BC_cpu_snb_jkt_ivb_ivt_bdx_hsx cpu_snb;
-		struct BC_cpu_snb_jkt_ivb_ivt_bdx_hsx cpu_jkt;
-		struct BC_cpu_snb_jkt_ivb_ivt_bdx_hsx cpu_ivb;
-		struct BC_cpu_snb_jkt_ivb_ivt_bdx_hsx cpu_ivt;
-		struct BC_cpu_snb_jkt_ivb_ivt_bdx_hsx cpu_bdw;
-		struct BC_cpu_snb_jkt_ivb_ivt_bdx_hsx cpu_bdx;
-		struct BC_cpu_snb_jkt_ivb_ivt_bdx_hsx cpu_hsx;
-		struct BC_cpu_snb_jkt_ivb_ivt_bdx_hsx cpu_hsw;
-		struct BC_cpu_skl_kbl_cfl cpu_skl;
-		struct BC_cpu_skl_kbl_cfl cpu_kbl;
-		struct BC_cpu_skl_kbl_cfl cpu_cfl;
-		struct BC_cpu_apl_glk cpu_apl;
-		struct BC_cpu_apl_glk cpu_glk;
-		struct BC_cpu_atom_avn cpu_avn;
-		struct BC_cpu_atom_byt cpu_byt;
-	};
+/* Section offsets in the flash and counts, decoded from FLMAP0/1 */
+struct FD_Map {
+	u32 fcba; /* component section */
+	u32 frba; /* region section */
+	u32 fmba; /* master section */
+	u8 components;
+	u8 regions; /* NR, as written by the descriptor tool */
+	u8 masters; /* NM, as written by the descriptor tool */
+};
+
+/* Flash address ranges with the same region and protections */
+struct SPI_Interval {
+	u32 base;
+	u32 limit;
+	int region; /* -1 if no region covers the interval */
+	bool read_protected;
+	bool write_protected;
+};
+
+#define SPI_MAX_INTERVALS (2 * (SPI_MAX_REGIONS + SPI_MAX_PROTECTED_RANGES))
+
+/* Sorted, non-overlapping intervals built from the regions and PRs */
+struct SPI_ProtectionIndex {
+	unsigned int count;
+	struct SPI_Interval intervals[SPI_MAX_INTERVALS];
 };
 
 int read_SBASE(enum PCH_Arch pch_arch, enum CPU_Arch cpu_arch,
 	       struct SBASE *reg);
 int read_BC(enum PCH_Arch pch_arch, enum CPU_Arch cpu_arch, struct BC *reg);
 int read_SPIBAR(enum PCH_Arch pch_arch, enum CPU_Arch cpu_arch, u64 *offset);
+int find_SPI_controller(enum PCH_Arch pch_arch, enum CPU_Arch cpu_arch,
+			u8 *device, u8 *function);
+int read_BC_field(const struct BC *reg, enum BC_Field field, u64 *value);
+int read_SBASE_field(const struct SBASE *reg, enum SBASE_Field field,
+		     u64 *value);
 int read_BC_BIOSWE(const struct BC *reg, u64 *value);
 int read_BC_BLE(const struct BC *reg, u64 *value);
 int read_BC_SMM_BWP(const struct BC *reg, u64 *value);
 int read_SBASE_Base(const struct SBASE *reg, u64 *value);
+int visit_BC_fields(const struct BC *reg, Register_Field_Visitor *visitor,
+		    void *ctx);
+int visit_SBASE_fields(const struct SBASE *reg, Register_Field_Visitor *visitor,
+		       void *ctx);
+int read_SPI_regs(enum PCH_Arch pch_arch, enum CPU_Arch cpu_arch,
+		  struct SPI_Regs *regs);
+int read_SPI_field(const struct SPI_Regs *regs, enum SPI_Field field,
+		   u64 *value);
+unsigned int SPI_fcycle_size(const struct SPI_Regs *regs);
+unsigned int SPI_region_count(const struct SPI_Regs *regs);
+int read_SPI_region(const struct SPI_Regs *regs, unsigned int index,
+		    struct SPI_Region *region);
+unsigned int SPI_protected_range_count(const struct SPI_Regs *regs);
+int read_SPI_protected_range(const struct SPI_Regs *regs, unsigned int index,
+			     struct SPI_ProtectedRange *range);
+int visit_SPI_fields(const struct SPI_Regs *regs,
+		     Register_Field_Visitor *visitor, void *ctx);
+int read_SPI_descriptor(enum PCH_Arch pch_arch, enum CPU_Arch cpu_arch,
+			struct SPI_Descriptor *fd);
+unsigned int FD_region_count(const struct SPI_Descriptor *fd);
+unsigned int FD_master_count(const struct SPI_Descriptor *fd);
+int read_FD_region(const struct SPI_Descriptor *fd, unsigned int index,
+		   struct SPI_Region *region);
+int read_FD_master_access(const struct SPI_Descriptor *fd,
+			  unsigned int master, unsigned int region,
+			  bool *read, bool *write);
+const char *FD_master_name(unsigned int master);
+void read_FD_map(const struct SPI_Descriptor *fd, struct FD_Map *map);
+int read_BIOS_window(const struct BC *bc, const struct SPI_Regs *regs,
+		     struct BIOS_Window *window);
+void build_SPI_protection_index(const struct SPI_Regs *regs,
+				struct SPI_ProtectionIndex *index);
+const struct SPI_Interval *
+lookup_SPI_protection(const struct SPI_ProtectionIndex *index, u32 address);
+const char *SPI_region_name(int region);
+const char *SPI_region_owner(int region);
 int viddid2pch_arch(u64 vid, u64 did, enum PCH_Arch *arch);
 int viddid2cpu_arch(u64 vid, u64 did, enum CPU_Arch *arch);
+int add_device_ids(const char *mappings);
 #endif /* BIOS_DATA_ACCESS_H */
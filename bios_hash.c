@@ -0,0 +1,371 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * SPI LPC flash platform security driver
+ *
+ * Copyright 2020 (c) Richard Hughes (richard@hughsie.com)
+ *
+ * This file is licensed under  the terms of the GNU General Public
+ * License version 2. This program is licensed "as is" without any
+ * warranty of any kind, whether express or implied.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/module.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/sched/signal.h>
+#include <linux/sizes.h>
+#include <linux/slab.h>
+#include <crypto/hash.h>
+#include "flash_access.h"
+#include "register_snapshot.h"
+#include "bios_hash.h"
+
+#define HASH_CHUNK_SIZE SZ_64K
+
+/* Shared by every digest, allocated on first use */
+static DEFINE_MUTEX(tfm_lock);
+static struct crypto_shash *sha256_tfm;
+
+/* Digest of bios_region, valid while the lock state it was taken in holds */
+static DEFINE_MUTEX(bios_hash_lock);
+static u8 bios_hash_digest[SHA256_DIGEST_SIZE];
+static bool bios_hash_valid;
+static u64 bios_hash_lock_state;
+static u64 bios_hash_generation;
+
+/* Anything that changes what may have written the flash since it was hashed */
+static u64 lock_state(const struct register_snapshot *snap,
+		      const struct spi_snapshot *spi)
+{
+	struct SPI_ProtectedRange range;
+	u64 state = 0;
+	u64 value;
+	unsigned int i;
+
+	if (read_BC_BIOSWE(&snap->bc, &value) == 0)
+		state |= value << 0;
+	if (read_BC_BLE(&snap->bc, &value) == 0)
+		state |= value << 1;
+	if (read_BC_SMM_BWP(&snap->bc, &value) == 0)
+		state |= value << 2;
+	if (read_SPI_field(&spi->regs, SPI_HSFS_FLOCKDN, &value) == 0)
+		state |= value << 3;
+
+	for (i = 0; i < SPI_protected_range_count(&spi->regs); i++) {
+		if (read_SPI_protected_range(&spi->regs, i, &range) == 0)
+			state |= (u64)range.write_protected << (4 + i);
+	}
+
+	return state;
+}
+
+static struct crypto_shash *get_sha256_tfm(void)
+{
+	struct crypto_shash *tfm;
+
+	mutex_lock(&tfm_lock);
+	if (sha256_tfm == NULL) {
+		tfm = crypto_alloc_shash("sha256", 0, 0);
+		if (!IS_ERR(tfm))
+			sha256_tfm = tfm;
+	} else {
+		tfm = sha256_tfm;
+	}
+	mutex_unlock(&tfm_lock);
+
+	return tfm;
+}
+
+static int sha256_digest(struct crypto_shash *tfm, const void *data,
+			 unsigned int len, u8 *digest)
+{
+	SHASH_DESC_ON_STACK(desc, tfm);
+	int ret;
+
+	desc->tfm = tfm;
+	ret = crypto_shash_digest(desc, data, len, digest);
+	shash_desc_zero(desc);
+
+	return ret;
+}
+
+int bios_hash_sha256(const void *data, unsigned int len,
+		     u8 digest[SHA256_DIGEST_SIZE])
+{
+	struct crypto_shash *tfm = get_sha256_tfm();
+
+	if (IS_ERR(tfm))
+		return PTR_ERR(tfm);
+	return sha256_digest(tfm, data, len, digest);
+}
+
+/* Hashes bios_region a chunk at a time, with bios_hash_lock held */
+static int bios_hash_compute(struct crypto_shash *tfm,
+			     u8 digest[SHA256_DIGEST_SIZE])
+{
+	const u32 size = bios_window_size();
+	SHASH_DESC_ON_STACK(desc, tfm);
+	void *chunk;
+	u32 offset;
+	int ret;
+
+	if (size == 0)
+		return -ENODEV;
+
+	chunk = kvmalloc(HASH_CHUNK_SIZE, GFP_KERNEL);
+	if (chunk == NULL)
+		return -ENOMEM;
+
+	desc->tfm = tfm;
+	ret = crypto_shash_init(desc);
+	for (offset = 0; ret == 0 && offset < size; offset += HASH_CHUNK_SIZE) {
+		const u32 len = min_t(u32, size - offset, HASH_CHUNK_SIZE);
+
+		ret = bios_window_read(offset, chunk, len);
+		if (ret == 0)
+			ret = crypto_shash_update(desc, chunk, len);
+		if (ret == 0 && fatal_signal_pending(current))
+			ret = -EINTR;
+		cond_resched();
+	}
+	if (ret == 0)
+		ret = crypto_shash_final(desc, digest);
+
+	shash_desc_zero(desc);
+	kvfree(chunk);
+
+	return ret;
+}
+
+/* generation is the one of the snapshot the digest was taken in */
+int bios_hash_get(u8 digest[SHA256_DIGEST_SIZE], u64 *generation)
+{
+	struct register_snapshot snap;
+	struct spi_snapshot spi;
+	struct crypto_shash *tfm;
+	u64 state;
+	int ret = 0;
+
+	snapshot_get_spi(&snap, &spi);
+	state = lock_state(&snap, &spi);
+
+	mutex_lock(&bios_hash_lock);
+	if (bios_hash_valid && bios_hash_lock_state == state)
+		goto out;
+
+	tfm = get_sha256_tfm();
+	if (IS_ERR(tfm)) {
+		ret = PTR_ERR(tfm);
+		goto out_unlock;
+	}
+
+	ret = bios_hash_compute(tfm, bios_hash_digest);
+	if (ret != 0)
+		goto out_unlock;
+
+	bios_hash_valid = true;
+	bios_hash_lock_state = state;
+	bios_hash_generation = snap.generation;
+out:
+	memcpy(digest, bios_hash_digest, SHA256_DIGEST_SIZE);
+	*generation = bios_hash_generation;
+out_unlock:
+	mutex_unlock(&bios_hash_lock);
+	return ret;
+}
+
+void bios_hash_invalidate(void)
+{
+	mutex_lock(&bios_hash_lock);
+	bios_hash_valid = false;
+	mutex_unlock(&bios_hash_lock);
+}
+
+/*
+ * Merkle tree over the whole flash: each leaf is the SHA-256 of its data, then
+ * each node is the SHA-256 of its two children's digests. The last node of an
+ * odd level is carried up unchanged. A leaf the host isn't allowed to read,
+ * such as the ME region, gets the all-zeros MERKLE_UNREADABLE_LEAF digest.
+ */
+static DEFINE_MUTEX(merkle_lock);
+static u8 (*merkle_leaves)[SHA256_DIGEST_SIZE];
+static u32 merkle_leaf_count;
+static u8 merkle_root[SHA256_DIGEST_SIZE];
+static bool merkle_valid;
+static u64 merkle_lock_state;
+static u64 merkle_generation;
+
+/*
+ * Hashes the leaves one after the other, with merkle_lock held. Every flash
+ * read goes through the single set of hardware sequencing registers, so
+ * hashing several leaves at once wouldn't read the flash any faster.
+ */
+static int merkle_hash_leaves(struct crypto_shash *tfm)
+{
+	void *data;
+	int ret = 0;
+	u32 i;
+
+	data = kvmalloc(MERKLE_LEAF_SIZE, GFP_KERNEL);
+	if (data == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < merkle_leaf_count && ret == 0; i++) {
+		const u32 offset = i * MERKLE_LEAF_SIZE;
+		const u32 len =
+			min_t(u32, flash_size() - offset, MERKLE_LEAF_SIZE);
+
+		ret = flash_read(offset, data, len);
+		if (ret == 0) {
+			ret = sha256_digest(tfm, data, len, merkle_leaves[i]);
+		} else if (ret == -EIO) {
+			memset(merkle_leaves[i], MERKLE_UNREADABLE_LEAF,
+			       SHA256_DIGEST_SIZE);
+			ret = 0;
+		}
+		if (ret == 0 && fatal_signal_pending(current))
+			ret = -EINTR;
+		cond_resched();
+	}
+	kvfree(data);
+
+	return ret;
+}
+
+/* Folds the leaves up to the root, with merkle_lock held */
+static int merkle_hash_nodes(struct crypto_shash *tfm)
+{
+	u8 (*level)[SHA256_DIGEST_SIZE];
+	u32 count = merkle_leaf_count;
+	int ret = 0;
+	u32 i;
+
+	level = kvmalloc_array(count, SHA256_DIGEST_SIZE, GFP_KERNEL);
+	if (level == NULL)
+		return -ENOMEM;
+	memcpy(level, merkle_leaves, count * SHA256_DIGEST_SIZE);
+
+	while (count > 1 && ret == 0) {
+		for (i = 0; i < count / 2 && ret == 0; i++)
+			ret = sha256_digest(tfm, level[2 * i],
+					    2 * SHA256_DIGEST_SIZE, level[i]);
+		if (count % 2 != 0)
+			memcpy(level[count / 2], level[count - 1],
+			       SHA256_DIGEST_SIZE);
+		count = DIV_ROUND_UP(count, 2);
+	}
+	if (ret == 0)
+		memcpy(merkle_root, level[0], SHA256_DIGEST_SIZE);
+	kvfree(level);
+
+	return ret;
+}
+
+/* Rebuilds the tree unless it's still valid, with merkle_lock held */
+static int merkle_update(void)
+{
+	struct register_snapshot snap;
+	struct spi_snapshot spi;
+	struct crypto_shash *tfm;
+	const u32 size = flash_size();
+	u64 state;
+	int ret;
+
+	snapshot_get_spi(&snap, &spi);
+	state = lock_state(&snap, &spi);
+	if (merkle_valid && merkle_lock_state == state)
+		return 0;
+
+	merkle_valid = false;
+	if (size == 0)
+		return -ENODEV;
+
+	tfm = get_sha256_tfm();
+	if (IS_ERR(tfm))
+		return PTR_ERR(tfm);
+
+	if (merkle_leaf_count != DIV_ROUND_UP(size, MERKLE_LEAF_SIZE)) {
+		kvfree(merkle_leaves);
+		merkle_leaf_count = DIV_ROUND_UP(size, MERKLE_LEAF_SIZE);
+		merkle_leaves = kvmalloc_array(merkle_leaf_count,
+					       SHA256_DIGEST_SIZE, GFP_KERNEL);
+		if (merkle_leaves == NULL) {
+			merkle_leaf_count = 0;
+			return -ENOMEM;
+		}
+	}
+
+	ret = merkle_hash_leaves(tfm);
+	if (ret == 0)
+		ret = merkle_hash_nodes(tfm);
+	if (ret != 0)
+		return ret;
+
+	merkle_valid = true;
+	merkle_lock_state = state;
+	merkle_generation = snap.generation;
+
+	return 0;
+}
+
+int merkle_get_root(u8 root[SHA256_DIGEST_SIZE], u32 *leaf_count,
+		    u64 *generation)
+{
+	int ret;
+
+	mutex_lock(&merkle_lock);
+	ret = merkle_update();
+	if (ret == 0) {
+		memcpy(root, merkle_root, SHA256_DIGEST_SIZE);
+		*leaf_count = merkle_leaf_count;
+		*generation = merkle_generation;
+	}
+	mutex_unlock(&merkle_lock);
+
+	return ret;
+}
+
+/* Copies the leaf digests, back to back in flash order */
+ssize_t merkle_read_leaves(char __user *buf, size_t count, loff_t *ppos)
+{
+	ssize_t ret;
+
+	mutex_lock(&merkle_lock);
+	ret = merkle_update();
+	if (ret == 0)
+		ret = simple_read_from_buffer(buf, count, ppos, merkle_leaves,
+					      merkle_leaf_count *
+						      SHA256_DIGEST_SIZE);
+	mutex_unlock(&merkle_lock);
+
+	return ret;
+}
+
+void merkle_invalidate(void)
+{
+	mutex_lock(&merkle_lock);
+	merkle_valid = false;
+	mutex_unlock(&merkle_lock);
+}
+
+void bios_hash_exit(void)
+{
+	mutex_lock(&bios_hash_lock);
+	bios_hash_valid = false;
+	mutex_unlock(&bios_hash_lock);
+
+	mutex_lock(&merkle_lock);
+	merkle_valid = false;
+	kvfree(merkle_leaves);
+	merkle_leaves = NULL;
+	merkle_leaf_count = 0;
+	mutex_unlock(&merkle_lock);
+
+	mutex_lock(&tfm_lock);
+	if (sha256_tfm != NULL)
+		crypto_free_shash(sha256_tfm);
+	sha256_tfm = NULL;
+	mutex_unlock(&tfm_lock);
+}
@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * SPI LPC flash platform security driver
+ *
+ * Copyright 2020 (c) Richard Hughes (richard@hughsie.com)
+ *
+ * This file is licensed under  the terms of the GNU General Public
+ * License version 2. This program is licensed "as is" without any
+ * warranty of any kind, whether express or implied.
+ */
+#ifndef BIOS_HASH_H
+#define BIOS_HASH_H
+
+#include <linux/types.h>
+#include <linux/sizes.h>
+#include <linux/version.h>
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 11, 0)
+#include <crypto/sha2.h>
+#else
+#include <crypto/sha.h>
+#endif
+
+void bios_hash_exit(void);
+int bios_hash_sha256(const void *data, unsigned int len,
+		     u8 digest[SHA256_DIGEST_SIZE]);
+int bios_hash_get(u8 digest[SHA256_DIGEST_SIZE], u64 *generation);
+void bios_hash_invalidate(void);
+
+#define MERKLE_LEAF_SIZE SZ_64K
+#define MERKLE_UNREADABLE_LEAF 0x00 /* every byte of the digest */
+
+int merkle_get_root(u8 root[SHA256_DIGEST_SIZE], u32 *leaf_count,
+		    u64 *generation);
+ssize_t merkle_read_leaves(char __user *buf, size_t count, loff_t *ppos);
+void merkle_invalidate(void);
+
+#endif /* BIOS_HASH_H */
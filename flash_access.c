@@ -0,0 +1,711 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * SPI LPC flash platform security driver
+ *
+ * Copyright 2020 (c) Richard Hughes (richard@hughsie.com)
+ *
+ * This file is licensed under  the terms of the GNU General Public
+ * License version 2. This program is licensed "as is" without any
+ * warranty of any kind, whether express or implied.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/module.h>
+#include <linux/version.h>
+#include <linux/debugfs.h>
+#include <linux/bitmap.h>
+#include <linux/ktime.h>
+#include <linux/io.h>
+#include <linux/math64.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/sched/signal.h>
+#include <linux/seq_file.h>
+#include <linux/sizes.h>
+#include <linux/slab.h>
+#include "low_level_access.h"
+#include "flash_access.h"
+
+/* Hardware sequencing registers, offsets from SPIBAR */
+#define HSFS 0x04
+#define HSFC 0x06
+#define FADDR 0x08
+#define FDATA0 0x10
+#define FDATA_SIZE 64 /* FDATA0-15, also the largest FDBC can describe */
+
+#define HSFS_FDONE BIT(0)
+#define HSFS_FCERR BIT(1)
+#define HSFS_AEL BIT(2)
+#define HSFS_SCIP BIT(5)
+
+#define HSFC_FGO BIT(0)
+#define HSFC_FCYCLE_SHIFT 1
+#define HSFC_FCYCLE_READ 0
+#define HSFC_FCYCLE_READ_SFDP 5 /* only with the 4 bit FCYCLE of PCH 1xx+ */
+#define HSFC_FDBC_SHIFT 8
+#define HSFC_FDBC_MASK (0x3f << HSFC_FDBC_SHIFT)
+
+#define FADDR_MASK 0x07ffffff
+#define HWSEQ_TIMEOUT_US 10000
+
+/* Serializes the cycles, the controller only has one set of registers */
+static DEFINE_MUTEX(flash_lock);
+static u64 flash_spibar;
+static u16 flash_fcycle_mask;
+static u32 flash_size_bytes; /* 0 if hardware sequencing can't be used */
+
+/* PCI function of the SPI controller, which the kernel's SPI driver may own */
+static bool flash_controller_pci;
+static u8 flash_controller_device;
+static u8 flash_controller_function;
+
+static u64 flash_bytes_read;
+static u64 flash_read_ns;
+
+/* Probed once in flash_init() */
+#define SFDP_SIGNATURE 0x50444653 /* "SFDP" */
+#define SFDP_BFPT_ID 0xff00
+#define SFDP_BFPT_DWORDS 9
+static struct flash_sfdp flash_sfdp;
+
+/* Erased (all 0xFF) blocks, found by one scan on the first lookup */
+static u32 flash_erase_size = SZ_4K; /* smallest SFDP erase size, if any */
+static DEFINE_MUTEX(flash_erased_lock);
+static unsigned long *flash_erased;
+
+static struct BIOS_Window bios_window;
+static void __iomem *bios_window_mapping; /* NULL if only streamed */
+
+#define CALIBRATION_SIZE SZ_4K
+
+enum BIOS_Read_Path {
+	BIOS_READ_UNCALIBRATED,
+	BIOS_READ_MMIO,
+	BIOS_READ_HWSEQ,
+};
+
+static const char *const bios_read_path_names[] = {
+	[BIOS_READ_UNCALIBRATED] = "uncalibrated",
+	[BIOS_READ_MMIO] = "mmio",
+	[BIOS_READ_HWSEQ] = "hwseq",
+};
+
+/* Chosen by timing both paths on the first read of the window */
+static DEFINE_MUTEX(calibration_lock);
+static enum BIOS_Read_Path bios_read_path;
+static u64 calibration_mmio_kbps;
+static u64 calibration_hwseq_kbps;
+
+static int flash_probe_sfdp(struct flash_sfdp *sfdp);
+
+/*
+ * Narrows the erase block found so far to what SFDP says. SFDP only describes
+ * the chip at address 0, so the region based size, which covers every
+ * component of the descriptor, is kept.
+ */
+static void flash_apply_sfdp(void)
+{
+	unsigned int i;
+
+	if (flash_probe_sfdp(&flash_sfdp) != 0) {
+		pr_debug("No SFDP, keeping the region based geometry\n");
+		return;
+	}
+
+	flash_erase_size = 0;
+	for (i = 0; i < SFDP_ERASE_TYPES; i++) {
+		if (flash_sfdp.erase_sizes[i] != 0 &&
+		    (flash_erase_size == 0 ||
+		     flash_sfdp.erase_sizes[i] < flash_erase_size))
+			flash_erase_size = flash_sfdp.erase_sizes[i];
+	}
+	/* keep the bitmap small, erasing less than a page is unusual */
+	flash_erase_size = max_t(u32, flash_erase_size, PAGE_SIZE);
+}
+
+/*
+ * intel-spi-pci drives the same hardware sequencing registers without taking
+ * flash_lock, so a cycle of ours could return the data of one of its cycles.
+ */
+static bool flash_controller_owned(void)
+{
+	return flash_controller_pci &&
+	       pci_driver_bound(0x0, flash_controller_device,
+				flash_controller_function);
+}
+
+int flash_init(enum PCH_Arch pch_arch, enum CPU_Arch cpu_arch)
+{
+	struct SPI_Regs regs;
+	struct SPI_Region region;
+	u64 fdv = 0;
+	u32 size = 0;
+	unsigned int i;
+	int ret;
+
+	flash_size_bytes = 0;
+
+	ret = read_SPI_regs(pch_arch, cpu_arch, &regs);
+	if (ret == 0)
+		ret = read_SPIBAR(pch_arch, cpu_arch, &flash_spibar);
+	if (ret != 0)
+		return ret;
+
+	/* the regions, and hardware sequencing, need descriptor mode */
+	read_SPI_field(&regs, SPI_HSFS_FDV, &fdv);
+	if (fdv == 0)
+		return -ENODEV;
+
+	ret = find_SPI_controller(pch_arch, cpu_arch, &flash_controller_device,
+				  &flash_controller_function);
+	flash_controller_pci = ret == 0;
+	if (flash_controller_owned()) {
+		pr_info("SPI controller is bound to a driver, not using it\n");
+		return -EBUSY;
+	}
+
+	for (i = 0; i < SPI_region_count(&regs); i++) {
+		if (read_SPI_region(&regs, i, &region) == 0)
+			size = max(size, region.limit + 1);
+	}
+	if (size == 0)
+		return -ENODEV;
+
+	flash_fcycle_mask = GENMASK(SPI_fcycle_size(&regs) - 1, 0)
+			    << HSFC_FCYCLE_SHIFT;
+	flash_size_bytes = size;
+	flash_apply_sfdp();
+	pr_debug("Flash is 0x%x bytes, erased in 0x%x byte blocks\n",
+		 flash_size_bytes, flash_erase_size);
+
+	return 0;
+}
+
+void flash_exit(void)
+{
+	mutex_lock(&flash_lock);
+	flash_size_bytes = 0;
+	memset(&flash_sfdp, 0, sizeof(flash_sfdp));
+	mutex_unlock(&flash_lock);
+
+	mutex_lock(&flash_erased_lock);
+	bitmap_free(flash_erased);
+	flash_erased = NULL;
+	flash_erase_size = SZ_4K;
+	mutex_unlock(&flash_erased_lock);
+}
+
+u32 flash_size(void)
+{
+	return flash_size_bytes;
+}
+
+/* Runs one read cycle of up to FDATA_SIZE bytes, with flash_lock held */
+static int hwseq_read(u8 fcycle, u32 address, u8 *buffer, unsigned int size)
+{
+	u32 data[FDATA_SIZE / sizeof(u32)];
+	unsigned int i;
+	u32 hsfs;
+	u16 hsfc;
+	int ret;
+
+	/* another master may be running a cycle, wait for it to finish */
+	ret = mmio_poll_dword(flash_spibar + HSFS, HSFS_SCIP, false,
+			      HWSEQ_TIMEOUT_US, &hsfs);
+	if (ret == -ETIMEDOUT)
+		return -EBUSY;
+	if (ret != 0)
+		return ret;
+
+	/*
+	 * Writing back what was read clears the write-1-to-clear status bits
+	 * of the previous cycle and leaves the others, such as WRSDIS, as is.
+	 */
+	ret = mmio_write_word(flash_spibar + HSFS, (u16)hsfs);
+	ret |= mmio_write_dword(flash_spibar + FADDR, address & FADDR_MASK);
+	ret |= mmio_read_word(flash_spibar + HSFC, &hsfc);
+	if (ret != 0)
+		return -EIO;
+
+	hsfc &= ~(flash_fcycle_mask | HSFC_FDBC_MASK);
+	hsfc |= fcycle << HSFC_FCYCLE_SHIFT | (size - 1) << HSFC_FDBC_SHIFT |
+		HSFC_FGO;
+	if (mmio_write_word(flash_spibar + HSFC, hsfc) != 0)
+		return -EIO;
+
+	ret = mmio_poll_dword(flash_spibar + HSFS, HSFS_FDONE | HSFS_FCERR,
+			      true, HWSEQ_TIMEOUT_US, &hsfs);
+	if (ret != 0)
+		return ret;
+	if (hsfs & (HSFS_FCERR | HSFS_AEL))
+		return -EIO; /* blocked by FRAP or a protected range */
+
+	for (i = 0; i < DIV_ROUND_UP(size, sizeof(u32)); i++) {
+		if (mmio_read_dword(flash_spibar + FDATA0 + i * sizeof(u32),
+				    &data[i]) != 0)
+			return -EIO;
+	}
+	memcpy(buffer, data, size);
+
+	return 0;
+}
+
+/* Splits a read in bursts, with flash_lock held */
+static int hwseq_read_bursts(u8 fcycle, u32 address, void *buffer,
+			     size_t size, size_t *done)
+{
+	int ret = 0;
+
+	*done = 0;
+	if (flash_controller_owned())
+		return -EBUSY; /* the driver was bound after flash_init() */
+
+	while (*done < size) {
+		/* aligned bursts never cross a flash page */
+		unsigned int burst =
+			min_t(size_t, size - *done,
+			      FDATA_SIZE - (address + *done) % FDATA_SIZE);
+
+		ret = hwseq_read(fcycle, address + *done, buffer + *done,
+				 burst);
+		if (ret != 0)
+			break;
+		*done += burst;
+	}
+
+	return ret;
+}
+
+int flash_read(u32 address, void *buffer, size_t size)
+{
+	size_t done = 0;
+	u64 start;
+	int ret = 0;
+
+	mutex_lock(&flash_lock);
+	if (flash_size_bytes == 0) {
+		ret = -ENODEV;
+		goto out;
+	}
+	if (address >= flash_size_bytes || size > flash_size_bytes - address) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	start = ktime_get_ns();
+	ret = hwseq_read_bursts(HSFC_FCYCLE_READ, address, buffer, size,
+				&done);
+	flash_bytes_read += done;
+	flash_read_ns += ktime_get_ns() - start;
+out:
+	mutex_unlock(&flash_lock);
+
+	return ret;
+}
+
+static int flash_read_sfdp(u32 address, void *buffer, size_t size)
+{
+	size_t done;
+	int ret;
+
+	mutex_lock(&flash_lock);
+	ret = hwseq_read_bursts(HSFC_FCYCLE_READ_SFDP, address, buffer, size,
+				&done);
+	mutex_unlock(&flash_lock);
+
+	return ret;
+}
+
+/* Decodes the JEDEC Basic Flash Parameter Table, JESD216 */
+static void decode_bfpt(const u32 *bfpt, unsigned int dwords,
+			struct flash_sfdp *sfdp)
+{
+	unsigned int i;
+
+	sfdp->read_1_1_2 = bfpt[0] & BIT(16);
+	sfdp->read_1_2_2 = bfpt[0] & BIT(20);
+	sfdp->read_1_4_4 = bfpt[0] & BIT(21);
+	sfdp->read_1_1_4 = bfpt[0] & BIT(22);
+
+	if (bfpt[1] & BIT(31)) {
+		if ((bfpt[1] & ~BIT(31)) < 64)
+			sfdp->density = BIT_ULL(bfpt[1] & ~BIT(31)) / 8;
+	} else {
+		sfdp->density = ((u64)bfpt[1] + 1) / 8;
+	}
+
+	if (dwords >= 5) {
+		sfdp->read_2_2_2 = bfpt[4] & BIT(0);
+		sfdp->read_4_4_4 = bfpt[4] & BIT(4);
+	}
+
+	/* erase types 1-4: size exponent and opcode, in DWORD 8 and 9 */
+	for (i = 0; i < SFDP_ERASE_TYPES && dwords >= 9; i++) {
+		const u16 type = bfpt[7 + i / 2] >> (16 * (i % 2));
+		const u8 exponent = type & 0xff;
+
+		if (exponent == 0 || exponent >= 32)
+			continue;
+		sfdp->erase_sizes[i] = BIT(exponent);
+		sfdp->erase_opcodes[i] = type >> 8;
+	}
+}
+
+/* Finds and decodes the BFPT through SFDP read cycles */
+static int flash_probe_sfdp(struct flash_sfdp *sfdp)
+{
+	u32 bfpt[SFDP_BFPT_DWORDS] = { 0 };
+	u32 header[2];
+	u32 param[2];
+	unsigned int count;
+	unsigned int i;
+	unsigned int j;
+	int ret;
+
+	memset(sfdp, 0, sizeof(*sfdp));
+
+	if (flash_fcycle_mask >> HSFC_FCYCLE_SHIFT < HSFC_FCYCLE_READ_SFDP)
+		return -EOPNOTSUPP; /* no SFDP cycle on this controller */
+
+	ret = flash_read_sfdp(0, header, sizeof(header));
+	if (ret != 0)
+		return ret;
+	if (le32_to_cpu(header[0]) != SFDP_SIGNATURE)
+		return -ENODEV;
+
+	count = ((le32_to_cpu(header[1]) >> 16) & 0xff) + 1;
+	for (i = 0; i < count; i++) {
+		unsigned int dwords;
+		u32 pointer;
+		u16 id;
+
+		ret = flash_read_sfdp(8 + i * sizeof(param), param,
+				      sizeof(param));
+		if (ret != 0)
+			return ret;
+
+		id = (le32_to_cpu(param[0]) & 0xff) |
+		     (le32_to_cpu(param[1]) >> 24) << 8;
+		if (id != SFDP_BFPT_ID)
+			continue;
+
+		dwords = min_t(unsigned int, le32_to_cpu(param[0]) >> 24,
+			       SFDP_BFPT_DWORDS);
+		pointer = le32_to_cpu(param[1]) & 0xffffff;
+		ret = flash_read_sfdp(pointer, bfpt, dwords * sizeof(u32));
+		if (ret != 0)
+			return ret;
+
+		for (j = 0; j < dwords; j++)
+			bfpt[j] = le32_to_cpu(bfpt[j]);
+		sfdp->major = (le32_to_cpu(param[0]) >> 16) & 0xff;
+		sfdp->minor = (le32_to_cpu(param[0]) >> 8) & 0xff;
+		decode_bfpt(bfpt, dwords, sfdp);
+		sfdp->valid = true;
+
+		return 0;
+	}
+
+	return -ENOENT; /* no BFPT, which JESD216 requires */
+}
+
+int flash_get_sfdp(struct flash_sfdp *sfdp)
+{
+	if (!flash_sfdp.valid)
+		return -ENODEV;
+
+	*sfdp = flash_sfdp;
+	return 0;
+}
+
+/* Checks the reset vector end of the window against a streamed read */
+static bool bios_window_matches_flash(void)
+{
+	u8 streamed[FDATA_SIZE];
+	u8 mapped[FDATA_SIZE];
+	const u32 offset = bios_window.size - FDATA_SIZE;
+
+	if (flash_read(bios_window.flash_address + offset, streamed,
+		       sizeof(streamed)) != 0)
+		return true; /* nothing to compare with, trust BBS */
+
+	memcpy_fromio(mapped, bios_window_mapping + offset, sizeof(mapped));
+	return memcmp(streamed, mapped, sizeof(mapped)) == 0;
+}
+
+/* Call after flash_init(), hardware sequencing is used to check the window */
+int bios_window_init(enum PCH_Arch pch_arch, enum CPU_Arch cpu_arch)
+{
+	struct SPI_Regs regs;
+	struct BC bc;
+	int ret;
+
+	ret = read_BC(pch_arch, cpu_arch, &bc);
+	if (ret == 0)
+		ret = read_SPI_regs(pch_arch, cpu_arch, &regs);
+	if (ret == 0)
+		ret = read_BIOS_window(&bc, &regs, &bios_window);
+	if (ret != 0)
+		return ret;
+
+	if (!bios_window.decoded) {
+		pr_info("BIOS isn't decoded from SPI, streaming it instead\n");
+		return 0;
+	}
+
+	bios_window_mapping = ioremap(bios_window.base, bios_window.size);
+	if (bios_window_mapping == NULL) {
+		pr_warn("Failed to map BIOS window 0x%llx, streaming it\n",
+			bios_window.base);
+		return 0;
+	}
+
+	if (!bios_window_matches_flash()) {
+		pr_info("BIOS window doesn't match the flash, streaming it\n");
+		iounmap(bios_window_mapping);
+		bios_window_mapping = NULL;
+	}
+
+	return 0;
+}
+
+void bios_window_exit(void)
+{
+	if (bios_window_mapping != NULL)
+		iounmap(bios_window_mapping);
+	bios_window_mapping = NULL;
+	memset(&bios_window, 0, sizeof(bios_window));
+
+	mutex_lock(&calibration_lock);
+	bios_read_path = BIOS_READ_UNCALIBRATED;
+	calibration_mmio_kbps = 0;
+	calibration_hwseq_kbps = 0;
+	mutex_unlock(&calibration_lock);
+}
+
+/* Size of the window, 0 if it can neither be mapped nor streamed */
+u32 bios_window_size(void)
+{
+	if (bios_window_mapping == NULL && flash_size() == 0)
+		return 0;
+	return bios_window.size;
+}
+
+static u64 rate_kbps(u64 bytes, u64 ns)
+{
+	return ns != 0 ? div64_u64(bytes * 1000000, ns) : 0;
+}
+
+/* Times both paths on the end of the window, with calibration_lock held */
+static void bios_window_calibrate(void)
+{
+	const u32 size = min_t(u32, CALIBRATION_SIZE, bios_window.size);
+	const u32 offset = bios_window.size - size;
+	void *sample;
+	u64 start;
+	int ret;
+
+	if (bios_window_mapping == NULL || flash_size() == 0) {
+		bios_read_path = bios_window_mapping != NULL ? BIOS_READ_MMIO :
+							       BIOS_READ_HWSEQ;
+		return; /* nothing to choose from */
+	}
+
+	sample = kmalloc(size, GFP_KERNEL);
+	if (sample == NULL) {
+		bios_read_path = BIOS_READ_MMIO;
+		return;
+	}
+
+	start = ktime_get_ns();
+	memcpy_fromio(sample, bios_window_mapping + offset, size);
+	calibration_mmio_kbps = rate_kbps(size, ktime_get_ns() - start);
+
+	start = ktime_get_ns();
+	ret = flash_read(bios_window.flash_address + offset, sample, size);
+	calibration_hwseq_kbps =
+		ret == 0 ? rate_kbps(size, ktime_get_ns() - start) : 0;
+	kfree(sample);
+
+	bios_read_path = calibration_hwseq_kbps > calibration_mmio_kbps ?
+				 BIOS_READ_HWSEQ :
+				 BIOS_READ_MMIO;
+	pr_debug("BIOS reads use %s, mmio %llu kB/s, hwseq %llu kB/s\n",
+		 bios_read_path_names[bios_read_path], calibration_mmio_kbps,
+		 calibration_hwseq_kbps);
+}
+
+int bios_window_read(u32 offset, void *buffer, size_t size)
+{
+	enum BIOS_Read_Path path = READ_ONCE(bios_read_path);
+
+	if (offset >= bios_window.size || size > bios_window.size - offset)
+		return -EINVAL;
+
+	if (path == BIOS_READ_UNCALIBRATED) {
+		mutex_lock(&calibration_lock);
+		if (bios_read_path == BIOS_READ_UNCALIBRATED)
+			bios_window_calibrate();
+		path = bios_read_path;
+		mutex_unlock(&calibration_lock);
+	}
+
+	if (path == BIOS_READ_HWSEQ)
+		return flash_read(bios_window.flash_address + offset, buffer,
+				  size);
+
+	memcpy_fromio(buffer, bios_window_mapping + offset, size);
+	return 0;
+}
+
+int bios_window_mmap(struct file *filp __maybe_unused,
+		     struct vm_area_struct *vma)
+{
+	const unsigned long size = vma->vm_end - vma->vm_start;
+	const unsigned long pages = PAGE_ALIGN(bios_window.size) >> PAGE_SHIFT;
+
+	if (bios_window_mapping == NULL)
+		return -ENODEV; /* read() streams it instead */
+	if (vma->vm_pgoff >= pages ||
+	    size > (pages - vma->vm_pgoff) << PAGE_SHIFT)
+		return -EINVAL;
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	/* don't allow mprotect() to make it writable later */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+	vm_flags_clear(vma, VM_MAYWRITE);
+#else
+	vma->vm_flags &= ~VM_MAYWRITE;
+#endif
+
+	return io_remap_pfn_range(vma, vma->vm_start,
+				  (bios_window.base >> PAGE_SHIFT) +
+					  vma->vm_pgoff,
+				  size, pgprot_noncached(vma->vm_page_prot));
+}
+
+/* Reads the whole flash once, with flash_erased_lock held */
+static int flash_scan_erased(u32 size)
+{
+	const unsigned long count = DIV_ROUND_UP(size, flash_erase_size);
+	unsigned long *erased;
+	unsigned long block;
+	void *data;
+	int ret = 0;
+
+	if (flash_erased != NULL)
+		return 0;
+
+	erased = bitmap_zalloc(count, GFP_KERNEL);
+	data = kvmalloc(flash_erase_size, GFP_KERNEL);
+	if (erased == NULL || data == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	for (block = 0; block < count; block++) {
+		const u32 offset = block * flash_erase_size;
+		const u32 len = min_t(u32, size - offset, flash_erase_size);
+
+		/* a block the host isn't allowed to read counts as data */
+		ret = flash_read(offset, data, len);
+		if (ret == -EIO)
+			ret = 0;
+		else if (ret != 0)
+			goto out;
+		else if (memchr_inv(data, 0xff, len) == NULL)
+			set_bit(block, erased);
+
+		if (fatal_signal_pending(current)) {
+			ret = -EINTR;
+			goto out;
+		}
+		cond_resched();
+	}
+	flash_erased = erased;
+	erased = NULL;
+out:
+	kvfree(data);
+	bitmap_free(erased);
+	return ret;
+}
+
+/*
+ * Finds the first run of erased blocks at or after offset, as [start, end).
+ * Returns -ENOENT if there is none.
+ */
+int flash_find_erased(u32 offset, u32 *start, u32 *end)
+{
+	const u32 size = flash_size();
+	const unsigned long count = DIV_ROUND_UP(size, flash_erase_size);
+	unsigned long first;
+	unsigned long last;
+	int ret;
+
+	if (size == 0)
+		return -ENODEV;
+	if (offset >= size)
+		return -ENOENT;
+
+	mutex_lock(&flash_erased_lock);
+	ret = flash_scan_erased(size);
+	if (ret != 0) {
+		mutex_unlock(&flash_erased_lock);
+		return ret;
+	}
+	first = find_next_bit(flash_erased, count,
+			      DIV_ROUND_UP(offset, flash_erase_size));
+	last = find_next_zero_bit(flash_erased, count, first);
+	mutex_unlock(&flash_erased_lock);
+
+	if (first >= count)
+		return -ENOENT;
+
+	*start = first * flash_erase_size;
+	*end = min_t(u32, last * flash_erase_size, size);
+	return 0;
+}
+
+static int flash_read_mbps_show(struct seq_file *m, void *unused __maybe_unused)
+{
+	u64 bytes;
+	u64 ns;
+	u64 kbps;
+
+	mutex_lock(&flash_lock);
+	bytes = flash_bytes_read;
+	ns = flash_read_ns;
+	mutex_unlock(&flash_lock);
+
+	kbps = rate_kbps(bytes, ns);
+	seq_printf(m, "%llu.%03llu\n", kbps / 1000, kbps % 1000);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(flash_read_mbps);
+
+static int bios_read_path_show(struct seq_file *m, void *unused __maybe_unused)
+{
+	mutex_lock(&calibration_lock);
+	seq_printf(m, "path=%s\n", bios_read_path_names[bios_read_path]);
+	seq_printf(m, "mmio_mbps=%llu.%03llu\n", calibration_mmio_kbps / 1000,
+		   calibration_mmio_kbps % 1000);
+	seq_printf(m, "hwseq_mbps=%llu.%03llu\n", calibration_hwseq_kbps / 1000,
+		   calibration_hwseq_kbps % 1000);
+	mutex_unlock(&calibration_lock);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(bios_read_path);
+
+void flash_debugfs_init(struct dentry *dir)
+{
+	debugfs_create_u64("flash_bytes_read", 0400, dir, &flash_bytes_read);
+	debugfs_create_u64("flash_read_ns", 0400, dir, &flash_read_ns);
+	debugfs_create_file("flash_read_mbps", 0400, dir, NULL,
+			    &flash_read_mbps_fops);
+	debugfs_create_file("bios_read_path", 0400, dir, NULL,
+			    &bios_read_path_fops);
+}
@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * SPI LPC flash platform security driver
+ *
+ * Copyright 2020 (c) Richard Hughes (richard@hughsie.com)
+ *
+ * This file is licensed under  the terms of the GNU General Public
+ * License version 2. This program is licensed "as is" without any
+ * warranty of any kind, whether express or implied.
+ */
+#ifndef FLASH_ACCESS_H
+#define FLASH_ACCESS_H
+
+#include <linux/types.h>
+#include "bios_data_access.h"
+
+#define SFDP_ERASE_TYPES 4
+
+/* Flash geometry from the SFDP Basic Flash Parameter Table */
+struct flash_sfdp {
+	bool valid;
+	u8 major;
+	u8 minor;
+	u64 density; /* bytes */
+	bool read_1_1_2;
+	bool read_1_2_2;
+	bool read_1_1_4;
+	bool read_1_4_4;
+	bool read_2_2_2;
+	bool read_4_4_4;
+	u32 erase_sizes[SFDP_ERASE_TYPES]; /* 0 if the type isn't used */
+	u8 erase_opcodes[SFDP_ERASE_TYPES];
+};
+
+struct dentry;
+struct file;
+struct vm_area_struct;
+
+int flash_init(enum PCH_Arch pch_arch, enum CPU_Arch cpu_arch);
+void flash_exit(void);
+u32 flash_size(void);
+int flash_read(u32 address, void *buffer, size_t size);
+int flash_find_erased(u32 offset, u32 *start, u32 *end);
+int flash_get_sfdp(struct flash_sfdp *sfdp);
+void flash_debugfs_init(struct dentry *dir);
+
+int bios_window_init(enum PCH_Arch pch_arch, enum CPU_Arch cpu_arch);
+void bios_window_exit(void);
+u32 bios_window_size(void);
+int bios_window_read(u32 offset, void *buffer, size_t size);
+int bios_window_mmap(struct file *filp, struct vm_area_struct *vma);
+
+#endif /* FLASH_ACCESS_H */
@@ -0,0 +1,271 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * SPI LPC flash platform security driver
+ *
+ * Copyright 2020 (c) Richard Hughes (richard@hughsie.com)
+ *
+ * This file is licensed under  the terms of the GNU General Public
+ * License version 2. This program is licensed "as is" without any
+ * warranty of any kind, whether express or implied.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/module.h>
+#include <linux/crc32.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/sched/signal.h>
+#include <linux/slab.h>
+#include "flash_access.h"
+#include "bios_hash.h"
+#include "flash_index.h"
+
+/*
+ * Only these bytes of a block are read to fingerprint it, evenly spread.
+ * Changes outside of them go unnoticed until the block is hashed again.
+ */
+#define SAMPLE_COUNT 16
+#define SAMPLE_SIZE 64
+
+/*
+ * Each pass also rehashes one block in FULL_REHASH_PASSES whatever its
+ * fingerprint, rotating with the generation, so a change outside of the
+ * samples is found within that many passes.
+ */
+#define FULL_REHASH_PASSES 16
+
+/* Per-block digests of the previous pass, see spi_lpc_index.h */
+static DEFINE_MUTEX(flash_index_lock);
+static struct spi_lpc_index_entry *flash_index_entries;
+static u32 flash_index_block_count;
+static u64 flash_index_generation;
+
+/* Resizes the index to the flash, dropping it if the size changed */
+static int flash_index_resize(u32 block_count)
+{
+	if (flash_index_entries != NULL &&
+	    flash_index_block_count == block_count)
+		return 0;
+
+	kvfree(flash_index_entries);
+	flash_index_block_count = 0;
+	flash_index_entries = kvcalloc(block_count,
+				       sizeof(*flash_index_entries),
+				       GFP_KERNEL);
+	if (flash_index_entries == NULL)
+		return -ENOMEM;
+	flash_index_block_count = block_count;
+
+	return 0;
+}
+
+static int fingerprint_block(u32 offset, u32 len, u32 *fingerprint)
+{
+	u8 sample[SAMPLE_SIZE];
+	const u32 stride = FLASH_INDEX_BLOCK_SIZE / SAMPLE_COUNT;
+	u32 crc = ~0;
+	u32 at;
+	int ret;
+
+	for (at = 0; at + SAMPLE_SIZE <= len; at += stride) {
+		ret = flash_read(offset + at, sample, SAMPLE_SIZE);
+		if (ret != 0)
+			return ret;
+		crc = crc32_le(crc, sample, SAMPLE_SIZE);
+	}
+	*fingerprint = ~crc;
+
+	return 0;
+}
+
+/* Fingerprints a block and rehashes it if needed, returns -EIO if blocked */
+static int flash_index_block(struct spi_lpc_index_entry *entry, u32 offset,
+			     u32 len, u64 generation, bool forced, void *block)
+{
+	u8 digest[SHA256_DIGEST_SIZE];
+	u32 fingerprint;
+	int ret;
+
+	ret = fingerprint_block(offset, len, &fingerprint);
+	if (ret != 0)
+		return ret;
+	if (!forced && entry->changed != 0 &&
+	    entry->fingerprint == fingerprint)
+		return 0; /* assume unchanged */
+
+	ret = flash_read(offset, block, len);
+	if (ret == 0)
+		ret = bios_hash_sha256(block, len, digest);
+	if (ret != 0)
+		return ret;
+
+	if (entry->changed == 0 ||
+	    memcmp(entry->sha256, digest, sizeof(digest)) != 0)
+		entry->changed = generation;
+	entry->fingerprint = fingerprint;
+	memcpy(entry->sha256, digest, sizeof(digest));
+
+	return 0;
+}
+
+/*
+ * One pass over the flash, with flash_index_lock held. Blocks the host isn't
+ * allowed to read are skipped. A pass that fails isn't given a generation: the
+ * changes it already recorded are reported by the next pass that completes.
+ */
+static int flash_index_update(void)
+{
+	const u32 size = flash_size();
+	const u64 generation = flash_index_generation + 1;
+	void *block;
+	u32 i;
+	int ret;
+
+	if (size == 0)
+		return -ENODEV;
+
+	ret = flash_index_resize(DIV_ROUND_UP(size, FLASH_INDEX_BLOCK_SIZE));
+	if (ret != 0)
+		return ret;
+
+	block = kvmalloc(FLASH_INDEX_BLOCK_SIZE, GFP_KERNEL);
+	if (block == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < flash_index_block_count && ret == 0; i++) {
+		const u32 offset = i * FLASH_INDEX_BLOCK_SIZE;
+		const u32 len = min_t(u32, size - offset,
+				      FLASH_INDEX_BLOCK_SIZE);
+		const bool forced = i % FULL_REHASH_PASSES ==
+				    generation % FULL_REHASH_PASSES;
+
+		ret = flash_index_block(&flash_index_entries[i], offset, len,
+					generation, forced, block);
+		if (ret == -EIO)
+			ret = 0; /* protected by FRAP, such as the ME region */
+		if (ret == 0 && fatal_signal_pending(current))
+			ret = -EINTR;
+		cond_resched();
+	}
+	kvfree(block);
+
+	if (ret == 0)
+		flash_index_generation = generation;
+
+	return ret;
+}
+
+/*
+ * Runs a new pass and lists the offsets of the blocks that changed after the
+ * since generation, one per line, following the pass generation.
+ */
+char *flash_index_changes(u64 since, size_t *len)
+{
+	const size_t line_size = sizeof("0x00000000\n");
+	size_t size;
+	char *text;
+	u32 i;
+	int ret;
+
+	mutex_lock(&flash_index_lock);
+	ret = flash_index_update();
+	if (ret != 0) {
+		text = ERR_PTR(ret);
+		goto out;
+	}
+	if (since == FLASH_INDEX_LAST_PASS)
+		since = flash_index_generation - 1;
+
+	size = sizeof("generation=18446744073709551615\n") +
+	       flash_index_block_count * line_size;
+	text = kvmalloc(size, GFP_KERNEL);
+	if (text == NULL) {
+		text = ERR_PTR(-ENOMEM);
+		goto out;
+	}
+
+	*len = scnprintf(text, size, "generation=%llu\n",
+			 flash_index_generation);
+	for (i = 0; i < flash_index_block_count; i++) {
+		if (flash_index_entries[i].changed > since)
+			*len += scnprintf(text + *len, size - *len, "0x%08x\n",
+					  i * FLASH_INDEX_BLOCK_SIZE);
+	}
+out:
+	mutex_unlock(&flash_index_lock);
+	return text;
+}
+
+ssize_t flash_index_save(char __user *buf, size_t count, loff_t *ppos)
+{
+	struct spi_lpc_index_header header = {
+		.magic = SPI_LPC_INDEX_MAGIC,
+		.version = SPI_LPC_INDEX_VERSION,
+		.block_size = FLASH_INDEX_BLOCK_SIZE,
+	};
+	size_t size;
+	void *data;
+	ssize_t ret;
+
+	mutex_lock(&flash_index_lock);
+	header.block_count = flash_index_block_count;
+	header.generation = flash_index_generation;
+
+	size = sizeof(header) +
+	       flash_index_block_count * sizeof(*flash_index_entries);
+	data = kvmalloc(size, GFP_KERNEL);
+	if (data == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	memcpy(data, &header, sizeof(header));
+	memcpy(data + sizeof(header), flash_index_entries,
+	       size - sizeof(header));
+
+	ret = simple_read_from_buffer(buf, count, ppos, data, size);
+	kvfree(data);
+out:
+	mutex_unlock(&flash_index_lock);
+	return ret;
+}
+
+/* Replaces the index with one saved earlier, for the same flash size */
+int flash_index_load(const void *data, size_t size)
+{
+	const struct spi_lpc_index_header *header = data;
+	const u32 block_count =
+		DIV_ROUND_UP(flash_size(), FLASH_INDEX_BLOCK_SIZE);
+	int ret;
+
+	if (size < sizeof(*header) || header->magic != SPI_LPC_INDEX_MAGIC ||
+	    header->version != SPI_LPC_INDEX_VERSION ||
+	    header->block_size != FLASH_INDEX_BLOCK_SIZE)
+		return -EINVAL;
+	if (block_count == 0 || header->block_count != block_count ||
+	    size != sizeof(*header) +
+			    block_count * sizeof(*flash_index_entries))
+		return -EINVAL;
+
+	mutex_lock(&flash_index_lock);
+	ret = flash_index_resize(block_count);
+	if (ret == 0) {
+		memcpy(flash_index_entries, data + sizeof(*header),
+		       block_count * sizeof(*flash_index_entries));
+		flash_index_generation = header->generation;
+	}
+	mutex_unlock(&flash_index_lock);
+
+	return ret;
+}
+
+void flash_index_exit(void)
+{
+	mutex_lock(&flash_index_lock);
+	kvfree(flash_index_entries);
+	flash_index_entries = NULL;
+	flash_index_block_count = 0;
+	flash_index_generation = 0;
+	mutex_unlock(&flash_index_lock);
+}
@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * SPI LPC flash platform security driver
+ *
+ * Copyright 2020 (c) Richard Hughes (richard@hughsie.com)
+ *
+ * This file is licensed under  the terms of the GNU General Public
+ * License version 2. This program is licensed "as is" without any
+ * warranty of any kind, whether express or implied.
+ */
+#ifndef FLASH_INDEX_H
+#define FLASH_INDEX_H
+
+#include <linux/types.h>
+#include <linux/limits.h>
+#include <linux/sizes.h>
+#include "spi_lpc_index.h"
+
+#define FLASH_INDEX_BLOCK_SIZE SZ_64K
+#define FLASH_INDEX_LAST_PASS U64_MAX /* changes seen by the new pass */
+
+void flash_index_exit(void);
+char *flash_index_changes(u64 since, size_t *len);
+ssize_t flash_index_save(char __user *buf, size_t count, loff_t *ppos);
+int flash_index_load(const void *data, size_t size);
+
+#endif /* FLASH_INDEX_H */
@@ -13,19 +13,85 @@
 
 #include <linux/version.h>
 #include <linux/pci.h>
+#include <linux/debugfs.h>
+#include <linux/iopoll.h>
 #include "low_level_access.h"
 
+/* Cached mapping of the SPIBAR window, set up once at detection time */
+static void __iomem *mmio_window;
+static u64 mmio_window_base;
+static size_t mmio_window_size;
+
+static atomic_t mmio_map_count = ATOMIC_INIT(0);
+static atomic_t mmio_unmap_count = ATOMIC_INIT(0);
+
+int mmio_map_window(u64 phys_address, size_t size)
+{
+	void __iomem *mapped_address;
+
+	mmio_unmap_window();
+
+	mapped_address = ioremap(phys_address, size);
+	if (mapped_address == NULL) {
+		pr_err("Failed to MAP IO window: 0x%llx\n", phys_address);
+		return -ENOMEM;
+	}
+	atomic_inc(&mmio_map_count);
+
+	mmio_window = mapped_address;
+	mmio_window_base = phys_address;
+	mmio_window_size = size;
+	pr_debug("Mapped MMIO window 0x%llx 0x%zx\n", phys_address, size);
+
+	return 0;
+}
+
+void mmio_unmap_window(void)
+{
+	if (mmio_window == NULL)
+		return;
+
+	iounmap(mmio_window);
+	atomic_inc(&mmio_unmap_count);
+	mmio_window = NULL;
+	mmio_window_base = 0;
+	mmio_window_size = 0;
+}
+
+/* Returns the cached mapping for the range, or NULL if outside the window */
+static void __iomem *mmio_window_lookup(u64 phys_address, size_t size)
+{
+	if (mmio_window == NULL || phys_address < mmio_window_base ||
+	    phys_address + size > mmio_window_base + mmio_window_size)
+		return NULL;
+
+	return mmio_window + (phys_address - mmio_window_base);
+}
+
+void mmio_debugfs_init(struct dentry *dir)
+{
+	debugfs_create_atomic_t("mmio_maps", 0400, dir, &mmio_map_count);
+	debugfs_create_atomic_t("mmio_unmaps", 0400, dir, &mmio_unmap_count);
+}
+
 #define GENERIC_MMIO_READ(Type, Suffix, function)                              \
 	int mmio_read_##Suffix(u64 phys_address, Type *value)                  \
 	{                                                                      \
 		int ret = 0;                                                   \
 		void __iomem *mapped_address =                                 \
-			ioremap(phys_address, sizeof(Type));                   \
+			mmio_window_lookup(phys_address, sizeof(Type));        \
 		pr_debug("Reading MMIO 0x%llx 0x%lx\n", phys_address,          \
 			 sizeof(Type));                                        \
 		if (mapped_address != NULL) {                                  \
+			*value = function(mapped_address);                     \
+			return 0;                                              \
+		}                                                              \
+		mapped_address = ioremap(phys_address, sizeof(Type));          \
+		if (mapped_address != NULL) {                                  \
+			atomic_inc(&mmio_map_count);                           \
 			*value = function(mapped_address);                     \
 			iounmap(mapped_address);                               \
+			atomic_inc(&mmio_unmap_count);                         \
 		} else {                                                       \
 			pr_err("Failed to MAP IO memory: 0x%llx\n",            \
 			       phys_address);                                  \
@@ -38,14 +104,147 @@ GENERIC_MMIO_READ(u16, word, readw)
 GENERIC_MMIO_READ(u32, dword, readl)
 #undef GENERIC_MMIO_READ
 
+int mmio_read_block(u64 phys_address, void *buffer, size_t size)
+{
+	void __iomem *mapped_address = mmio_window_lookup(phys_address, size);
+
+	pr_debug("Reading MMIO block 0x%llx 0x%zx\n", phys_address, size);
+	if (mapped_address != NULL) {
+		memcpy_fromio(buffer, mapped_address, size);
+		return 0;
+	}
+
+	mapped_address = ioremap(phys_address, size);
+	if (mapped_address == NULL) {
+		pr_err("Failed to MAP IO memory: 0x%llx\n", phys_address);
+		return -1;
+	}
+	atomic_inc(&mmio_map_count);
+	memcpy_fromio(buffer, mapped_address, size);
+	iounmap(mapped_address);
+	atomic_inc(&mmio_unmap_count);
+
+	return 0;
+}
+
+#define GENERIC_MMIO_WRITE(Type, Suffix, function)                             \
+	int mmio_write_##Suffix(u64 phys_address, Type value)                  \
+	{                                                                      \
+		void __iomem *mapped_address =                                 \
+			mmio_window_lookup(phys_address, sizeof(Type));        \
+		pr_debug("Writing MMIO 0x%llx 0x%lx\n", phys_address,          \
+			 sizeof(Type));                                        \
+		if (mapped_address != NULL) {                                  \
+			function(value, mapped_address);                       \
+			return 0;                                              \
+		}                                                              \
+		mapped_address = ioremap(phys_address, sizeof(Type));          \
+		if (mapped_address == NULL) {                                  \
+			pr_err("Failed to MAP IO memory: 0x%llx\n",            \
+			       phys_address);                                  \
+			return -1;                                             \
+		}                                                              \
+		atomic_inc(&mmio_map_count);                                   \
+		function(value, mapped_address);                               \
+		iounmap(mapped_address);                                       \
+		atomic_inc(&mmio_unmap_count);                                 \
+		return 0;                                                      \
+	}
+GENERIC_MMIO_WRITE(u16, word, writew)
+GENERIC_MMIO_WRITE(u32, dword, writel)
+#undef GENERIC_MMIO_WRITE
+
+/*
+ * Busy-polls until one of the mask bits is set, or until all of them are clear
+ * if set is false. Only the mapped window can be polled, remapping on every
+ * iteration would dwarf the wait itself.
+ */
+int mmio_poll_dword(u64 phys_address, u32 mask, bool set, u64 timeout_us,
+		    u32 *value)
+{
+	void __iomem *mapped_address =
+		mmio_window_lookup(phys_address, sizeof(u32));
+
+	if (mapped_address == NULL)
+		return -EIO;
+
+	return readl_poll_timeout(mapped_address, *value,
+				  ((*value & mask) != 0) == set, 0, timeout_us);
+}
+
+/* Devices accessed by the decoders, resolved once and held for the lifetime */
+struct pinned_pci_dev {
+	u8 bus;
+	u8 devfn;
+	struct pci_dev *dev;
+};
+
+static struct pinned_pci_dev pinned_devs[] = {
+	{ .bus = 0x0, .devfn = PCI_DEVFN(0x1f, 0x0) },
+	{ .bus = 0x0, .devfn = PCI_DEVFN(0x1f, 0x5) },
+	{ .bus = 0x0, .devfn = PCI_DEVFN(0xd, 0x2) },
+	{ .bus = 0x0, .devfn = PCI_DEVFN(0x0, 0x0) },
+};
+
+void pci_pin_devices(void)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(pinned_devs); i++) {
+		struct pinned_pci_dev *pinned = &pinned_devs[i];
+
+		/* hidden devices aren't found, they use the bus fallback */
+		pinned->dev = pci_get_domain_bus_and_slot(0, pinned->bus,
+							  pinned->devfn);
+		pr_debug("PCI 0x%x 0x%x %s\n", pinned->bus, pinned->devfn,
+			 pinned->dev != NULL ? "pinned" : "not found");
+	}
+}
+
+void pci_unpin_devices(void)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(pinned_devs); i++) {
+		pci_dev_put(pinned_devs[i].dev);
+		pinned_devs[i].dev = NULL;
+	}
+}
+
+static struct pci_dev *pci_pinned_lookup(u64 bus, u64 device, u64 function)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(pinned_devs); i++) {
+		if (pinned_devs[i].bus == bus &&
+		    pinned_devs[i].devfn == PCI_DEVFN(device, function))
+			return pinned_devs[i].dev;
+	}
+	return NULL;
+}
+
+/* Whether a kernel driver, such as intel-spi-pci, is bound to the device */
+bool pci_driver_bound(u64 bus, u64 device, u64 function)
+{
+	struct pci_dev *dev = pci_pinned_lookup(bus, device, function);
+
+	return dev != NULL && READ_ONCE(dev->driver) != NULL;
+}
+
 #define GENERIC_PCI_READ(Suffix, Type)                                         \
 	int pci_read_##Suffix(Type *value, u64 bus, u64 device, u64 function,  \
 			      u64 offset)                                      \
 	{                                                                      \
 		int ret;                                                       \
-		struct pci_bus *found_bus = pci_find_bus(0, bus);              \
+		struct pci_dev *pinned_dev =                                   \
+			pci_pinned_lookup(bus, device, function);              \
+		struct pci_bus *found_bus;                                     \
 		pr_debug("Reading PCI 0x%llx 0x%llx 0x%llx 0x%llx \n", bus,    \
 			 device, function, offset);                            \
+		if (pinned_dev != NULL)                                        \
+			return pci_read_config_##Suffix(pinned_dev, offset,    \
+							value);                \
+		found_bus = pci_find_bus(0, bus);                              \
 		if (found_bus != NULL) {                                       \
 			ret = pci_bus_read_config_##Suffix(                    \
 				found_bus, PCI_DEVFN(device, function),        \
@@ -3,12 +3,27 @@
 
 #include <linux/types.h>
 
+void pci_pin_devices(void);
+void pci_unpin_devices(void);
+bool pci_driver_bound(u64 bus, u64 device, u64 function);
+
 int pci_read_byte(u8 *value, u64 bus, u64 device, u64 function, u64 offset);
 int pci_read_word(u16 *value, u64 bus, u64 device, u64 function, u64 offset);
 int pci_read_dword(u32 *value, u64 bus, u64 device, u64 function, u64 offset);
 
+struct dentry;
+
+int mmio_map_window(u64 phys_address, size_t size);
+void mmio_unmap_window(void);
+void mmio_debugfs_init(struct dentry *dir);
+
 int mmio_read_byte(u64 phys_address, u8 *value);
 int mmio_read_word(u64 phys_address, u16 *value);
 int mmio_read_dword(u64 phys_address, u32 *value);
+int mmio_read_block(u64 phys_address, void *buffer, size_t size);
+int mmio_write_word(u64 phys_address, u16 value);
+int mmio_write_dword(u64 phys_address, u32 value);
+int mmio_poll_dword(u64 phys_address, u32 mask, bool set, u64 timeout_us,
+		    u32 *value);
 
 #endif /* LOW_LEVEL_H */
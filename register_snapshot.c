@@ -0,0 +1,379 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * SPI LPC flash platform security driver
+ *
+ * Copyright 2020 (c) Richard Hughes (richard@hughsie.com)
+ *
+ * This file is licensed under  the terms of the GNU General Public
+ * License version 2. This program is licensed "as is" without any
+ * warranty of any kind, whether express or implied.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/module.h>
+#include <linux/version.h>
+#include <linux/debugfs.h>
+#include <linux/jiffies.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/seqlock.h>
+#include <linux/workqueue.h>
+#include "register_snapshot.h"
+
+static unsigned int snapshot_interval_ms = 1000;
+module_param(snapshot_interval_ms, uint, 0644);
+MODULE_PARM_DESC(snapshot_interval_ms,
+		 "Minimum time in ms between two hardware register reads");
+
+static int publish_interval_set(const char *val,
+				const struct kernel_param *kp);
+static const struct kernel_param_ops publish_interval_ops = {
+	.set = publish_interval_set,
+	.get = param_get_uint,
+};
+
+static unsigned int publish_interval_ms = 1000;
+module_param_cb(publish_interval_ms, &publish_interval_ops,
+		&publish_interval_ms, 0644);
+MODULE_PARM_DESC(publish_interval_ms,
+		 "Time in ms between two timer refreshes of the snapshot page, "
+		 "0 only updates it when the snapshot is read");
+
+static enum PCH_Arch snapshot_pch_arch;
+static enum CPU_Arch snapshot_cpu_arch;
+
+/* Readers are lock-free, snapshot_lock only serializes the writers */
+static DEFINE_MUTEX(snapshot_lock);
+static struct {
+	seqcount_t seq;
+	struct register_snapshot snap;
+} snapshot_cache ____cacheline_aligned = {
+	.seq = SEQCNT_ZERO(snapshot_cache.seq),
+};
+
+/* Written in the same refresh, so BC readers never copy the SPI registers */
+static struct {
+	seqcount_t seq;
+	struct spi_snapshot spi;
+} spi_cache ____cacheline_aligned = {
+	.seq = SEQCNT_ZERO(spi_cache.seq),
+};
+
+/* Page exported to userspace, written with snapshot_lock held */
+static struct spi_lpc_snapshot_page *snapshot_page;
+
+/* The sampler runs from snapshot_init() to snapshot_exit(), page or not */
+static bool snapshot_sampling;
+#define WATCH_INTERVAL_MIN_MS 100U
+
+static void snapshot_publish_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(snapshot_publish_work, snapshot_publish_fn);
+
+/* Called under snapshot_lock when a refresh sees different registers */
+static Snapshot_Change_Fn *snapshot_change_fn;
+
+/* Open files waiting for changes, they keep the sampler running */
+static atomic_t snapshot_watchers = ATOMIC_INIT(0);
+
+static atomic_t snapshot_issued_count = ATOMIC_INIT(0);
+static atomic_t snapshot_coalesced_count = ATOMIC_INIT(0);
+
+static void snapshot_valid_field(void *ctx, int field,
+				 const char *name __maybe_unused,
+				 u64 value __maybe_unused)
+{
+	*(u32 *)ctx |= BIT(field);
+}
+
+void snapshot_export(const struct register_snapshot *snap,
+		     struct spi_lpc_snapshot *abi)
+{
+	u32 bc_valid = 0;
+	u32 sbase_valid = 0;
+
+	memset(abi, 0, sizeof(*abi));
+	abi->version = SPI_LPC_SNAPSHOT_VERSION;
+	abi->size = sizeof(*abi);
+	abi->generation = snap->generation;
+	abi->pch_arch = snapshot_pch_arch;
+	abi->cpu_arch = snapshot_cpu_arch;
+
+	if (snap->bc_status == 0) {
+		abi->bc = snap->bc.raw;
+		visit_BC_fields(&snap->bc, snapshot_valid_field, &bc_valid);
+	}
+	if (snap->sbase_status == 0) {
+		abi->sbase = snap->sbase.raw;
+		visit_SBASE_fields(&snap->sbase, snapshot_valid_field,
+				   &sbase_valid);
+	}
+	abi->bc_valid = bc_valid;
+	abi->sbase_valid = sbase_valid;
+}
+
+/* Same protocol as a seqcount: seq is odd while the page is being written */
+static void snapshot_publish(const struct register_snapshot *snap)
+{
+	struct spi_lpc_snapshot abi;
+
+	if (snapshot_page == NULL)
+		return;
+
+	snapshot_export(snap, &abi);
+	WRITE_ONCE(snapshot_page->seq, snapshot_page->seq + 1);
+	smp_wmb();
+	memcpy(&snapshot_page->snapshot, &abi, sizeof(abi));
+	smp_wmb();
+	WRITE_ONCE(snapshot_page->seq, snapshot_page->seq + 1);
+}
+
+static void snapshot_read(struct register_snapshot *snap)
+{
+	unsigned int seq;
+
+	do {
+		seq = read_seqcount_begin(&snapshot_cache.seq);
+		*snap = snapshot_cache.snap;
+	} while (read_seqcount_retry(&snapshot_cache.seq, seq));
+}
+
+static bool snapshot_differs(const struct register_snapshot *a,
+			      const struct register_snapshot *b)
+{
+	return a->bc_status != b->bc_status || a->bc.raw != b->bc.raw ||
+	       a->sbase_status != b->sbase_status ||
+	       a->sbase.raw != b->sbase.raw;
+}
+
+/* Must be called with snapshot_lock held */
+static void snapshot_refresh(void)
+{
+	struct register_snapshot fresh;
+	struct register_snapshot prev = snapshot_cache.snap;
+	struct spi_snapshot spi;
+
+	/* do the hardware access outside of the write section */
+	memset(&fresh, 0, sizeof(fresh));
+	fresh.bc_status =
+		read_BC(snapshot_pch_arch, snapshot_cpu_arch, &fresh.bc);
+	fresh.sbase_status =
+		read_SBASE(snapshot_pch_arch, snapshot_cpu_arch, &fresh.sbase);
+	fresh.timestamp = get_jiffies_64();
+	fresh.generation = snapshot_cache.snap.generation + 1;
+
+	memset(&spi, 0, sizeof(spi));
+	spi.status =
+		read_SPI_regs(snapshot_pch_arch, snapshot_cpu_arch, &spi.regs);
+	spi.generation = fresh.generation;
+
+	preempt_disable();
+	write_seqcount_begin(&spi_cache.seq);
+	spi_cache.spi = spi;
+	write_seqcount_end(&spi_cache.seq);
+	write_seqcount_begin(&snapshot_cache.seq);
+	snapshot_cache.snap = fresh;
+	write_seqcount_end(&snapshot_cache.seq);
+	preempt_enable();
+
+	snapshot_publish(&fresh);
+
+	if (snapshot_change_fn != NULL && prev.generation != 0 &&
+	    snapshot_differs(&prev, &fresh))
+		snapshot_change_fn(&prev, &fresh);
+}
+
+/* Samples at publish_interval_ms, or snapshot_interval_ms for watchers */
+static unsigned int snapshot_sample_interval_ms(void)
+{
+	unsigned int interval_ms = READ_ONCE(publish_interval_ms);
+
+	/* an open flag file mustn't keep the hardware busy */
+	if (interval_ms == 0 && atomic_read(&snapshot_watchers) > 0)
+		interval_ms = max(READ_ONCE(snapshot_interval_ms),
+				  WATCH_INTERVAL_MIN_MS);
+
+	return interval_ms;
+}
+
+static void snapshot_schedule_publish(void)
+{
+	const unsigned int interval_ms = snapshot_sample_interval_ms();
+
+	if (READ_ONCE(snapshot_sampling) && interval_ms != 0)
+		schedule_delayed_work(&snapshot_publish_work,
+				      msecs_to_jiffies(interval_ms));
+}
+
+static void snapshot_publish_fn(struct work_struct *work __maybe_unused)
+{
+	mutex_lock(&snapshot_lock);
+	snapshot_refresh();
+	atomic_inc(&snapshot_issued_count);
+	mutex_unlock(&snapshot_lock);
+
+	snapshot_schedule_publish();
+}
+
+/* Re-arm the timer so a new interval applies without waiting for the old */
+static int publish_interval_set(const char *val,
+				const struct kernel_param *kp)
+{
+	unsigned int interval_ms;
+	int ret = param_set_uint(val, kp);
+
+	if (ret != 0)
+		return ret;
+
+	mutex_lock(&snapshot_lock);
+	interval_ms = snapshot_sample_interval_ms();
+	if (snapshot_sampling && interval_ms != 0)
+		mod_delayed_work(system_wq, &snapshot_publish_work,
+				 msecs_to_jiffies(interval_ms));
+	mutex_unlock(&snapshot_lock);
+	return 0;
+}
+
+void snapshot_init(enum PCH_Arch pch_arch, enum CPU_Arch cpu_arch)
+{
+	snapshot_page = (void *)get_zeroed_page(GFP_KERNEL);
+	if (snapshot_page == NULL)
+		pr_warn("Couldn't allocate the snapshot page\n");
+
+	mutex_lock(&snapshot_lock);
+	snapshot_pch_arch = pch_arch;
+	snapshot_cpu_arch = cpu_arch;
+	snapshot_refresh();
+	WRITE_ONCE(snapshot_sampling, true);
+	mutex_unlock(&snapshot_lock);
+
+	snapshot_schedule_publish();
+}
+
+void snapshot_exit(void)
+{
+	struct spi_lpc_snapshot_page *page;
+
+	/* stops publish_interval_set() from arming the work again */
+	mutex_lock(&snapshot_lock);
+	WRITE_ONCE(snapshot_sampling, false);
+	page = snapshot_page;
+	snapshot_page = NULL;
+	mutex_unlock(&snapshot_lock);
+
+	cancel_delayed_work_sync(&snapshot_publish_work);
+	free_page((unsigned long)page);
+}
+
+void snapshot_notify(Snapshot_Change_Fn *fn)
+{
+	mutex_lock(&snapshot_lock);
+	snapshot_change_fn = fn;
+	mutex_unlock(&snapshot_lock);
+}
+
+void snapshot_watch(void)
+{
+	atomic_inc(&snapshot_watchers);
+	snapshot_schedule_publish();
+}
+
+void snapshot_unwatch(void)
+{
+	atomic_dec(&snapshot_watchers);
+}
+
+/* Latest snapshot, without ever touching the hardware */
+void snapshot_peek(struct register_snapshot *snap)
+{
+	snapshot_read(snap);
+}
+
+static bool snapshot_is_stale(const struct register_snapshot *snap)
+{
+	const u64 expiry = snap->timestamp +
+			   msecs_to_jiffies(READ_ONCE(snapshot_interval_ms));
+
+	return snap->generation == 0 ||
+	       time_after_eq64(get_jiffies_64(), expiry);
+}
+
+void snapshot_get(struct register_snapshot *snap)
+{
+	u64 stale_generation;
+
+	snapshot_read(snap);
+	if (!snapshot_is_stale(snap))
+		return;
+
+	/*
+	 * Single-flight: the first caller does the hardware access, anyone
+	 * arriving while it's in flight waits for it and shares the result.
+	 */
+	stale_generation = snap->generation;
+	mutex_lock(&snapshot_lock);
+	if (snapshot_cache.snap.generation == stale_generation) {
+		snapshot_refresh();
+		atomic_inc(&snapshot_issued_count);
+	} else {
+		atomic_inc(&snapshot_coalesced_count);
+	}
+	*snap = snapshot_cache.snap;
+	mutex_unlock(&snapshot_lock);
+}
+
+static void spi_read(struct spi_snapshot *spi)
+{
+	unsigned int seq;
+
+	do {
+		seq = read_seqcount_begin(&spi_cache.seq);
+		*spi = spi_cache.spi;
+	} while (read_seqcount_retry(&spi_cache.seq, seq));
+}
+
+/* Like snapshot_get(), plus the SPI registers read in the same refresh */
+void snapshot_get_spi(struct register_snapshot *snap, struct spi_snapshot *spi)
+{
+	snapshot_get(snap);
+	spi_read(spi);
+
+	/*
+	 * A refresh landed in between. It writes spi_cache before the
+	 * snapshot, so re-reading the snapshot catches up with it.
+	 */
+	while (spi->generation != snap->generation) {
+		cpu_relax();
+		snapshot_read(snap);
+		spi_read(spi);
+	}
+}
+
+int snapshot_mmap(struct file *filp __maybe_unused, struct vm_area_struct *vma)
+{
+	if (snapshot_page == NULL)
+		return -ENOMEM;
+	if (vma->vm_pgoff != 0 || vma->vm_end - vma->vm_start > PAGE_SIZE)
+		return -EINVAL;
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	/* don't allow mprotect() to make it writable later */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+	vm_flags_clear(vma, VM_MAYWRITE);
+#else
+	vma->vm_flags &= ~VM_MAYWRITE;
+#endif
+
+	return remap_pfn_range(vma, vma->vm_start,
+			       virt_to_phys(snapshot_page) >> PAGE_SHIFT,
+			       vma->vm_end - vma->vm_start, vma->vm_page_prot);
+}
+
+void snapshot_debugfs_init(struct dentry *dir)
+{
+	debugfs_create_atomic_t("reads_issued", 0400, dir,
+				&snapshot_issued_count);
+	debugfs_create_atomic_t("reads_coalesced", 0400, dir,
+				&snapshot_coalesced_count);
+}
@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * SPI LPC flash platform security driver
+ *
+ * Copyright 2020 (c) Richard Hughes (richard@hughsie.com)
+ *
+ * This file is licensed under  the terms of the GNU General Public
+ * License version 2. This program is licensed "as is" without any
+ * warranty of any kind, whether express or implied.
+ */
+#ifndef REGISTER_SNAPSHOT_H
+#define REGISTER_SNAPSHOT_H
+
+#include <linux/types.h>
+#include "bios_data_access.h"
+#include "spi_lpc_snapshot.h"
+
+/* Decoded registers from one hardware read cycle */
+struct register_snapshot {
+	struct BC bc;
+	struct SBASE sbase;
+	int bc_status;
+	int sbase_status;
+	u64 timestamp; /* jiffies when the registers were read */
+	u64 generation; /* incremented on every refresh, 0 means never read */
+};
+
+/* SPI controller registers, cached apart as they don't fit a cache line */
+struct spi_snapshot {
+	struct SPI_Regs regs;
+	int status;
+	u64 generation; /* of the register_snapshot read in the same refresh */
+};
+
+typedef void Snapshot_Change_Fn(const struct register_snapshot *prev,
+				const struct register_snapshot *next);
+
+struct dentry;
+struct file;
+struct vm_area_struct;
+
+void snapshot_init(enum PCH_Arch pch_arch, enum CPU_Arch cpu_arch);
+void snapshot_exit(void);
+void snapshot_get(struct register_snapshot *snap);
+void snapshot_peek(struct register_snapshot *snap);
+void snapshot_get_spi(struct register_snapshot *snap, struct spi_snapshot *spi);
+void snapshot_notify(Snapshot_Change_Fn *fn);
+void snapshot_watch(void);
+void snapshot_unwatch(void);
+int snapshot_mmap(struct file *filp, struct vm_area_struct *vma);
+void snapshot_debugfs_init(struct dentry *dir);
+void snapshot_export(const struct register_snapshot *snap,
+		     struct spi_lpc_snapshot *abi);
+
+#endif /* REGISTER_SNAPSHOT_H */
@@ -0,0 +1,38 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+/*
+ * SPI LPC flash platform security driver
+ *
+ * Copyright 2020 (c) Richard Hughes (richard@hughsie.com)
+ *
+ * This file is licensed under  the terms of the GNU General Public
+ * License version 2. This program is licensed "as is" without any
+ * warranty of any kind, whether express or implied.
+ */
+#ifndef SPI_LPC_INDEX_H
+#define SPI_LPC_INDEX_H
+
+#include <linux/types.h>
+
+/*
+ * Binary layout of /sys/kernel/security/firmware/flash_index: a header
+ * followed by block_count entries, one per block_size bytes of flash.
+ */
+#define SPI_LPC_INDEX_MAGIC 0x58444e49 /* "INDX" */
+#define SPI_LPC_INDEX_VERSION 1
+
+struct spi_lpc_index_header {
+	__u32 magic; /* SPI_LPC_INDEX_MAGIC */
+	__u32 version; /* SPI_LPC_INDEX_VERSION */
+	__u32 block_size;
+	__u32 block_count;
+	__u64 generation; /* number of the last pass over the flash */
+} __attribute__((packed));
+
+struct spi_lpc_index_entry {
+	__u32 fingerprint; /* CRC32 of the sampled bytes */
+	__u32 reserved;
+	__u64 changed; /* pass that last saw the block change, 0 if unset */
+	__u8 sha256[32];
+} __attribute__((packed));
+
+#endif /* SPI_LPC_INDEX_H */
@@ -13,9 +13,20 @@
 #define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
 
 #include <linux/module.h>
+#include <linux/version.h>
 #include <linux/security.h>
+#include <linux/debugfs.h>
+#include <linux/fsnotify.h>
+#include <linux/poll.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/string.h>
 #include "bios_data_access.h"
 #include "low_level_access.h"
+#include "register_snapshot.h"
+#include "flash_access.h"
+#include "bios_hash.h"
+#include "flash_index.h"
 
 #define SIZE_WORD sizeof(u16)
 #define WORD_MASK 0xFFFFu
@@ -25,12 +36,43 @@
 static enum PCH_Arch pch_arch;
 static enum CPU_Arch cpu_arch;
 
+static char *extra_ids;
+module_param(extra_ids, charp, 0444);
+MODULE_PARM_DESC(extra_ids,
+		 "Extra vid:did=arch device ID mappings, comma separated");
+
+/* Serializes detection, as device_ids can retry it after load */
+static DEFINE_MUTEX(device_ids_lock);
+static bool device_ids_written;
+static bool platform_attached;
+
 static struct dentry *spi_dir;
 static struct dentry *spi_bioswe;
 static struct dentry *spi_ble;
 static struct dentry *spi_smm_bwp;
+static struct dentry *spi_summary;
+static struct dentry *spi_snapshot;
+static struct dentry *spi_snapshot_page;
+static struct dentry *spi_protection;
+static struct dentry *spi_flash;
+static struct dentry *spi_bios_region;
+static struct dentry *spi_bios_hash;
+static struct dentry *spi_flash_merkle_root;
+static struct dentry *spi_flash_merkle_leaves;
+static struct dentry *spi_flash_index;
+static struct dentry *spi_flash_changes;
+static struct dentry *spi_flash_sfdp;
+static struct dentry *spi_flash_descriptor;
+static struct dentry *spi_flash_erased;
+
+/* Decoded once when the platform is attached */
+static struct SPI_Descriptor flash_descriptor;
+static int flash_descriptor_status = -ENODEV;
+static struct dentry *spi_device_ids;
 
-typedef int Read_BC_Flag_Fn(struct BC *bc, u64 *value);
+static struct dentry *spi_debug_dir;
+
+typedef int Read_BC_Flag_Fn(const struct BC *bc, u64 *value);
 
 static int get_pci_vid_did(u8 bus, u8 dev, u8 fun, u16 *vid, u16 *did)
 {
@@ -79,30 +121,84 @@ static int get_pch_cpu(enum PCH_Arch *pch_arch, enum CPU_Arch *cpu_arch)
 	return cpu_res != 0 && pch_res != 0 ? -EIO : 0;
 }
 
+/* Map the SPI controller registers once so the read path doesn't remap them */
+static void map_spibar(void)
+{
+	u64 spibar;
+
+	if (read_SPIBAR(pch_arch, cpu_arch, &spibar) != 0)
+		return; /* no MMIO registers used on this platform */
+
+	if (mmio_map_window(spibar, SPIBAR_SIZE) != 0)
+		pr_warn("Couldn't map SPIBAR, using per-read mappings\n");
+}
+
 /* Buffer to return: always 3 because of the following chars:
  *     value \n \0
  */
 #define BUFFER_SIZE 3
 
+/* Woken whenever the sampler sees the registers change */
+static DECLARE_WAIT_QUEUE_HEAD(bc_flag_wait);
+
+/* Value each opener of a flag file has last been given */
+struct bc_flag_state {
+	u64 seen;
+	int seen_status;
+};
+
+static int bc_flag_value(struct inode *inode,
+			 const struct register_snapshot *snap, u64 *value)
+{
+	*value = 0;
+	if (inode->i_private == NULL)
+		return -EIO;
+	if (snap->bc_status != 0)
+		return snap->bc_status;
+
+	return ((Read_BC_Flag_Fn *)inode->i_private)(&snap->bc, value);
+}
+
+static int bc_flag_open(struct inode *inode, struct file *filp)
+{
+	struct bc_flag_state *state = kzalloc(sizeof(*state), GFP_KERNEL);
+	struct register_snapshot snap;
+
+	if (state == NULL)
+		return -ENOMEM;
+
+	snapshot_get(&snap);
+	state->seen_status = bc_flag_value(inode, &snap, &state->seen);
+	filp->private_data = state;
+	snapshot_watch();
+
+	return 0;
+}
+
+static int bc_flag_release(struct inode *inode __maybe_unused,
+			   struct file *filp)
+{
+	snapshot_unwatch();
+	kfree(filp->private_data);
+	return 0;
+}
+
 static ssize_t bc_flag_read(struct file *filp, char __user *buf, size_t count,
 			    loff_t *ppos)
 {
+	struct bc_flag_state *state = filp->private_data;
 	char tmp[BUFFER_SIZE];
 	ssize_t ret;
 	u64 value = 0;
-	struct BC bc;
+	struct register_snapshot snap;
 
 	if (*ppos == BUFFER_SIZE)
 		return 0; /* nothing else to read */
 
-	if (file_inode(filp)->i_private == NULL)
-		return -EIO;
-
-	ret = read_BC(pch_arch, cpu_arch, &bc);
-
-	if (ret == 0)
-		ret = ((Read_BC_Flag_Fn *)file_inode(filp)->i_private)(&bc,
-								       &value);
+	snapshot_get(&snap);
+	ret = bc_flag_value(file_inode(filp), &snap, &value);
+	state->seen = value;
+	state->seen_status = ret;
 
 	if (ret != 0)
 		return ret;
@@ -113,57 +209,830 @@ static ssize_t bc_flag_read(struct file *filp, char __user *buf, size_t count,
 	return ret;
 }
 
+/* Like sysfs, EPOLLPRI|EPOLLERR means seek to 0 and read the new value */
+static __poll_t bc_flag_poll(struct file *filp, poll_table *wait)
+{
+	struct bc_flag_state *state = filp->private_data;
+	struct register_snapshot snap;
+	u64 value;
+	int status;
+
+	poll_wait(filp, &bc_flag_wait, wait);
+
+	snapshot_peek(&snap);
+	status = bc_flag_value(file_inode(filp), &snap, &value);
+	if (status != state->seen_status || value != state->seen)
+		return DEFAULT_POLLMASK | EPOLLERR | EPOLLPRI;
+
+	return DEFAULT_POLLMASK;
+}
+
 static const struct file_operations bc_flags_ops = {
+	.owner = THIS_MODULE,
+	.open = bc_flag_open,
+	.release = bc_flag_release,
 	.read = bc_flag_read,
+	.poll = bc_flag_poll,
 };
 
-static int __init mod_init(void)
+static void summary_show_field(void *ctx, int field __maybe_unused,
+			       const char *name, u64 value)
+{
+	seq_printf((struct seq_file *)ctx, "%s=%llu\n", name, value);
+}
+
+static int summary_show(struct seq_file *m, void *unused __maybe_unused)
+{
+	struct register_snapshot snap;
+	struct spi_snapshot spi;
+
+	snapshot_get_spi(&snap, &spi);
+	if (snap.bc_status != 0)
+		return snap.bc_status;
+
+	seq_printf(m, "generation=%llu\n", snap.generation);
+	visit_BC_fields(&snap.bc, summary_show_field, m);
+	if (snap.sbase_status == 0)
+		visit_SBASE_fields(&snap.sbase, summary_show_field, m);
+	if (spi.status == 0)
+		visit_SPI_fields(&spi.regs, summary_show_field, m);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(summary);
+
+static ssize_t snapshot_file_read(struct file *filp __maybe_unused,
+				  char __user *buf, size_t count, loff_t *ppos)
 {
+	struct register_snapshot snap;
+	struct spi_lpc_snapshot abi;
+
+	snapshot_get(&snap);
+	snapshot_export(&snap, &abi);
+
+	return simple_read_from_buffer(buf, count, ppos, &abi, sizeof(abi));
+}
+
+static const struct file_operations snapshot_ops = {
+	.owner = THIS_MODULE,
+	.read = snapshot_file_read,
+};
+
+static const struct file_operations snapshot_page_ops = {
+	.owner = THIS_MODULE,
+	.mmap = snapshot_mmap,
+};
+
+/* Rebuilt from the snapshot only when its generation moves */
+static DEFINE_MUTEX(protection_lock);
+static struct SPI_ProtectionIndex protection_index;
+static u64 protection_generation;
+
+/* Address written by each opener of the protection file */
+struct protection_query {
+	u32 address;
+	bool valid;
+};
+
+static int protection_open(struct inode *inode __maybe_unused,
+			   struct file *filp)
+{
+	filp->private_data = kzalloc(sizeof(struct protection_query),
+				     GFP_KERNEL);
+	return filp->private_data == NULL ? -ENOMEM : 0;
+}
+
+static int protection_release(struct inode *inode __maybe_unused,
+			      struct file *filp)
+{
+	kfree(filp->private_data);
+	return 0;
+}
+
+static ssize_t protection_write(struct file *filp, const char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	struct protection_query *query = filp->private_data;
+	int ret = kstrtou32_from_user(buf, count, 0, &query->address);
+
+	if (ret != 0)
+		return ret;
+	query->valid = true;
+	*ppos = 0; /* the next read describes the new address */
+
+	return count;
+}
+
+/* Masters FLMSTR lets write the region, or its conventional owner */
+static void region_owners(int region, char *buf, size_t size)
+{
+	const struct SPI_Descriptor *fd = &flash_descriptor;
+	unsigned int master;
+	size_t len = 0;
+
+	if (flash_descriptor_status != 0 || region < 0) {
+		strscpy(buf, SPI_region_owner(region), size);
+		return;
+	}
+
+	for (master = 0; master < FD_master_count(fd); master++) {
+		bool read;
+		bool write;
+
+		if (read_FD_master_access(fd, master, region, &read,
+					  &write) != 0 ||
+		    !write)
+			continue;
+		len += scnprintf(buf + len, size - len, "%s%s",
+				 len != 0 ? "," : "", FD_master_name(master));
+	}
+	if (len == 0)
+		strscpy(buf, "none", size);
+}
+
+static ssize_t protection_read(struct file *filp, char __user *buf,
+			       size_t count, loff_t *ppos)
+{
+	struct protection_query *query = filp->private_data;
+	const struct SPI_Interval *found;
+	struct SPI_Interval interval = { .region = -1 };
+	struct register_snapshot snap;
+	struct spi_snapshot spi;
+	u64 host_read = 0;
+	u64 host_write = 0;
+	char owners[64];
+	char tmp[256];
+	int len;
+
+	if (!query->valid)
+		return -EINVAL; /* an address must be written first */
+
+	snapshot_get_spi(&snap, &spi);
+	if (spi.status != 0)
+		return spi.status;
+
+	mutex_lock(&protection_lock);
+	if (protection_generation != spi.generation) {
+		build_SPI_protection_index(&spi.regs, &protection_index);
+		protection_generation = spi.generation;
+	}
+	found = lookup_SPI_protection(&protection_index, query->address);
+	if (found != NULL)
+		interval = *found;
+	mutex_unlock(&protection_lock);
+
+	if (interval.region >= 0) {
+		read_SPI_field(&spi.regs, SPI_FRAP_BRRA, &host_read);
+		read_SPI_field(&spi.regs, SPI_FRAP_BRWA, &host_write);
+		host_read = (host_read >> interval.region) & 1;
+		host_write = (host_write >> interval.region) & 1;
+	}
+	region_owners(interval.region, owners, sizeof(owners));
+
+	len = scnprintf(tmp, sizeof(tmp),
+			"address=0x%08x\nregion=%s\nowner=%s\n"
+			"host_read=%llu\nhost_write=%llu\n"
+			"read_protected=%d\nwrite_protected=%d\n",
+			query->address, SPI_region_name(interval.region),
+			owners, host_read, host_write, interval.read_protected,
+			interval.write_protected);
+
+	return simple_read_from_buffer(buf, count, ppos, tmp, len);
+}
+
+static const struct file_operations protection_ops = {
+	.owner = THIS_MODULE,
+	.open = protection_open,
+	.release = protection_release,
+	.read = protection_read,
+	.write = protection_write,
+};
+
+typedef int Read_Flash_Fn(u32 address, void *buffer, size_t size);
+
+/* Copies [*ppos, size) to userspace a page at a time */
+static ssize_t stream_read(char __user *buf, size_t count, loff_t *ppos,
+			   u32 size, Read_Flash_Fn *read_fn)
+{
+	size_t done = 0;
+	void *chunk;
 	int ret = 0;
-	if (get_pch_cpu(&pch_arch, &cpu_arch) != 0) {
-		pr_err("Couldn't detect PCH or CPU\n");
-		return -EIO;
+
+	if (size == 0)
+		return -ENODEV;
+	if (*ppos < 0)
+		return -EINVAL;
+	if (*ppos >= size)
+		return 0;
+	count = min_t(size_t, count, size - *ppos);
+
+	chunk = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (chunk == NULL)
+		return -ENOMEM;
+
+	while (done < count) {
+		const size_t len = min_t(size_t, count - done, PAGE_SIZE);
+
+		ret = read_fn(*ppos, chunk, len);
+		if (ret == 0 && copy_to_user(buf + done, chunk, len) != 0)
+			ret = -EFAULT;
+		if (ret != 0)
+			break;
+		*ppos += len;
+		done += len;
+
+		if (fatal_signal_pending(current))
+			break;
+		cond_resched();
 	}
+	kfree(chunk);
 
-	spi_dir = securityfs_create_dir("firmware", NULL);
-	if (IS_ERR(spi_dir)) {
-		pr_err("Couldn't create firmware securityfs dir\n");
-		return PTR_ERR(spi_dir);
+	return done > 0 ? done : ret;
+}
+
+static ssize_t flash_file_read(struct file *filp __maybe_unused,
+			       char __user *buf, size_t count, loff_t *ppos)
+{
+	return stream_read(buf, count, ppos, flash_size(), flash_read);
+}
+
+static loff_t flash_file_llseek(struct file *filp, loff_t offset, int whence)
+{
+	return fixed_size_llseek(filp, offset, whence, flash_size());
+}
+
+static const struct file_operations flash_ops = {
+	.owner = THIS_MODULE,
+	.read = flash_file_read,
+	.llseek = flash_file_llseek,
+};
+
+static ssize_t bios_region_read(struct file *filp __maybe_unused,
+				char __user *buf, size_t count, loff_t *ppos)
+{
+	return stream_read(buf, count, ppos, bios_window_size(),
+			   bios_window_read);
+}
+
+static loff_t bios_region_llseek(struct file *filp, loff_t offset, int whence)
+{
+	return fixed_size_llseek(filp, offset, whence, bios_window_size());
+}
+
+static const struct file_operations bios_region_ops = {
+	.owner = THIS_MODULE,
+	.read = bios_region_read,
+	.llseek = bios_region_llseek,
+	.mmap = bios_window_mmap,
+};
+
+static ssize_t bios_hash_read(struct file *filp __maybe_unused,
+			      char __user *buf, size_t count, loff_t *ppos)
+{
+	u8 digest[SHA256_DIGEST_SIZE];
+	u64 generation;
+	char tmp[128];
+	int len;
+	int ret;
+
+	ret = bios_hash_get(digest, &generation);
+	if (ret != 0)
+		return ret;
+
+	len = scnprintf(tmp, sizeof(tmp), "sha256=%*phN\ngeneration=%llu\n",
+			SHA256_DIGEST_SIZE, digest, generation);
+	return simple_read_from_buffer(buf, count, ppos, tmp, len);
+}
+
+/* Any write asks for the next read to hash the flash again */
+static ssize_t bios_hash_write(struct file *filp __maybe_unused,
+			       const char __user *buf __maybe_unused,
+			       size_t count, loff_t *ppos __maybe_unused)
+{
+	bios_hash_invalidate();
+	return count;
+}
+
+static const struct file_operations bios_hash_ops = {
+	.owner = THIS_MODULE,
+	.read = bios_hash_read,
+	.write = bios_hash_write,
+};
+
+static ssize_t flash_merkle_root_read(struct file *filp __maybe_unused,
+				      char __user *buf, size_t count,
+				      loff_t *ppos)
+{
+	u8 root[SHA256_DIGEST_SIZE];
+	u32 leaf_count;
+	u64 generation;
+	char tmp[160];
+	int len;
+	int ret;
+
+	ret = merkle_get_root(root, &leaf_count, &generation);
+	if (ret != 0)
+		return ret;
+
+	len = scnprintf(tmp, sizeof(tmp),
+			"sha256=%*phN\nleaf_size=%u\nleaves=%u\n"
+			"generation=%llu\n",
+			SHA256_DIGEST_SIZE, root, MERKLE_LEAF_SIZE, leaf_count,
+			generation);
+	return simple_read_from_buffer(buf, count, ppos, tmp, len);
+}
+
+/* Any write asks for the next read to rebuild the tree */
+static ssize_t flash_merkle_root_write(struct file *filp __maybe_unused,
+				       const char __user *buf __maybe_unused,
+				       size_t count,
+				       loff_t *ppos __maybe_unused)
+{
+	merkle_invalidate();
+	return count;
+}
+
+static const struct file_operations flash_merkle_root_ops = {
+	.owner = THIS_MODULE,
+	.read = flash_merkle_root_read,
+	.write = flash_merkle_root_write,
+};
+
+static ssize_t flash_merkle_leaves_read(struct file *filp __maybe_unused,
+					char __user *buf, size_t count,
+					loff_t *ppos)
+{
+	return merkle_read_leaves(buf, count, ppos);
+}
+
+static const struct file_operations flash_merkle_leaves_ops = {
+	.owner = THIS_MODULE,
+	.read = flash_merkle_leaves_read,
+};
+
+static ssize_t flash_index_read(struct file *filp __maybe_unused,
+				char __user *buf, size_t count, loff_t *ppos)
+{
+	return flash_index_save(buf, count, ppos);
+}
+
+/* The saved index has to be written back in a single write */
+static ssize_t flash_index_write(struct file *filp __maybe_unused,
+				 const char __user *buf, size_t count,
+				 loff_t *ppos)
+{
+	void *data;
+	int ret;
+
+	if (*ppos != 0)
+		return -EINVAL;
+	if (count > sizeof(struct spi_lpc_index_header) +
+			    (size_t)(SZ_4G / FLASH_INDEX_BLOCK_SIZE) *
+				    sizeof(struct spi_lpc_index_entry))
+		return -E2BIG;
+
+	data = vmemdup_user(buf, count);
+	if (IS_ERR(data))
+		return PTR_ERR(data);
+
+	ret = flash_index_load(data, count);
+	kvfree(data);
+
+	return ret != 0 ? ret : count;
+}
+
+static const struct file_operations flash_index_ops = {
+	.owner = THIS_MODULE,
+	.read = flash_index_read,
+	.write = flash_index_write,
+};
+
+/* Generation written by each opener of flash_changes, and its answer */
+struct flash_changes_query {
+	u64 since;
+	char *text;
+	size_t len;
+};
+
+static int flash_changes_open(struct inode *inode __maybe_unused,
+			      struct file *filp)
+{
+	struct flash_changes_query *query =
+		kzalloc(sizeof(*query), GFP_KERNEL);
+
+	if (query == NULL)
+		return -ENOMEM;
+	query->since = FLASH_INDEX_LAST_PASS;
+	filp->private_data = query;
+
+	return 0;
+}
+
+static int flash_changes_release(struct inode *inode __maybe_unused,
+				 struct file *filp)
+{
+	struct flash_changes_query *query = filp->private_data;
+
+	kvfree(query->text);
+	kfree(query);
+	return 0;
+}
+
+static ssize_t flash_changes_write(struct file *filp, const char __user *buf,
+				   size_t count, loff_t *ppos)
+{
+	struct flash_changes_query *query = filp->private_data;
+	int ret = kstrtou64_from_user(buf, count, 0, &query->since);
+
+	if (ret != 0)
+		return ret;
+
+	/* the next read runs a new pass */
+	kvfree(query->text);
+	query->text = NULL;
+	*ppos = 0;
+
+	return count;
+}
+
+static ssize_t flash_changes_read(struct file *filp, char __user *buf,
+				  size_t count, loff_t *ppos)
+{
+	struct flash_changes_query *query = filp->private_data;
+	char *text;
+
+	if (query->text == NULL) {
+		text = flash_index_changes(query->since, &query->len);
+		if (IS_ERR(text))
+			return PTR_ERR(text);
+		query->text = text;
 	}
 
-#define create_file(name, function)                                            \
+	return simple_read_from_buffer(buf, count, ppos, query->text,
+				       query->len);
+}
+
+static const struct file_operations flash_changes_ops = {
+	.owner = THIS_MODULE,
+	.open = flash_changes_open,
+	.release = flash_changes_release,
+	.read = flash_changes_read,
+	.write = flash_changes_write,
+};
+
+static int flash_sfdp_show(struct seq_file *m, void *unused __maybe_unused)
+{
+	struct flash_sfdp sfdp;
+	unsigned int i;
+	int ret;
+
+	ret = flash_get_sfdp(&sfdp);
+	if (ret != 0)
+		return ret;
+
+	seq_printf(m, "revision=%u.%u\n", sfdp.major, sfdp.minor);
+	seq_printf(m, "density=%llu\n", sfdp.density);
+	seq_printf(m, "read_1_1_2=%d\n", sfdp.read_1_1_2);
+	seq_printf(m, "read_1_2_2=%d\n", sfdp.read_1_2_2);
+	seq_printf(m, "read_1_1_4=%d\n", sfdp.read_1_1_4);
+	seq_printf(m, "read_1_4_4=%d\n", sfdp.read_1_4_4);
+	seq_printf(m, "read_2_2_2=%d\n", sfdp.read_2_2_2);
+	seq_printf(m, "read_4_4_4=%d\n", sfdp.read_4_4_4);
+	for (i = 0; i < SFDP_ERASE_TYPES; i++) {
+		if (sfdp.erase_sizes[i] == 0)
+			continue;
+		seq_printf(m, "erase_size_%u=%u\n", i + 1,
+			   sfdp.erase_sizes[i]);
+		seq_printf(m, "erase_opcode_%u=0x%02x\n", i + 1,
+			   sfdp.erase_opcodes[i]);
+	}
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(flash_sfdp);
+
+static int flash_descriptor_show(struct seq_file *m,
+				 void *unused __maybe_unused)
+{
+	const struct SPI_Descriptor *fd = &flash_descriptor;
+	struct SPI_Region region;
+	struct FD_Map map;
+	unsigned int master;
+	unsigned int i;
+
+	if (flash_descriptor_status != 0)
+		return flash_descriptor_status;
+
+	read_FD_map(fd, &map);
+	seq_printf(m, "components=%u nr=%u nm=%u\n", map.components,
+		   map.regions, map.masters);
+	seq_printf(m, "fcba=0x%03x frba=0x%03x fmba=0x%03x\n", map.fcba,
+		   map.frba, map.fmba);
+
+	seq_puts(m, "\nregion name              base       limit\n");
+	for (i = 0; i < FD_region_count(fd); i++) {
+		if (read_FD_region(fd, i, &region) != 0)
+			continue; /* unused */
+		seq_printf(m, "%-6u %-17s 0x%08x 0x%08x\n", i,
+			   SPI_region_name(i), region.base, region.limit);
+	}
+
+	seq_puts(m, "\nmaster ");
+	for (i = 0; i < FD_region_count(fd); i++)
+		seq_printf(m, " %-2u", i);
+	seq_putc(m, '\n');
+	for (master = 0; master < FD_master_count(fd); master++) {
+		seq_printf(m, "%-7s", FD_master_name(master));
+		for (i = 0; i < FD_region_count(fd); i++) {
+			bool read = false;
+			bool write = false;
+
+			read_FD_master_access(fd, master, i, &read, &write);
+			seq_printf(m, " %c%c", read ? 'r' : '-',
+				   write ? 'w' : '-');
+		}
+		seq_putc(m, '\n');
+	}
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(flash_descriptor);
+
+/* Runs of erased blocks, as offset and length, for archivers to skip */
+static int flash_erased_show(struct seq_file *m, void *unused __maybe_unused)
+{
+	u32 start;
+	u32 end = 0;
+	int ret;
+
+	while ((ret = flash_find_erased(end, &start, &end)) == 0)
+		seq_printf(m, "0x%08x 0x%08x\n", start, end - start);
+
+	return ret == -ENOENT ? 0 : ret;
+}
+DEFINE_SHOW_ATTRIBUTE(flash_erased);
+
+/* Runs under the snapshot lock, for every refresh that changed a register */
+static void bc_flags_changed(const struct register_snapshot *prev,
+			     const struct register_snapshot *next)
+{
+	struct dentry *const files[] = { spi_bioswe, spi_ble, spi_smm_bwp };
+	bool changed = false;
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(files); i++) {
+		struct inode *inode = d_inode(files[i]);
+		u64 before;
+		u64 after;
+
+		if (bc_flag_value(inode, prev, &before) ==
+			    bc_flag_value(inode, next, &after) &&
+		    before == after)
+			continue;
+
+		changed = true;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 11, 0)
+		fsnotify_inode(inode, FS_MODIFY);
+#endif
+	}
+
+	if (changed)
+		wake_up_interruptible(&bc_flag_wait);
+}
+
+/* Creates everything that needs a detected PCH or CPU */
+static int platform_attach(void)
+{
+	int ret = 0;
+
+	map_spibar();
+	snapshot_init(pch_arch, cpu_arch);
+	if (flash_init(pch_arch, cpu_arch) != 0)
+		pr_info("No hardware sequencing, the flash can't be read\n");
+	if (bios_window_init(pch_arch, cpu_arch) != 0)
+		pr_info("No BIOS region found, it can't be read\n");
+	flash_descriptor_status =
+		read_SPI_descriptor(pch_arch, cpu_arch, &flash_descriptor);
+
+#define create_file_mode(name, mode, data, fops)                               \
 	do {                                                                   \
-		spi_##name = securityfs_create_file(#name, 0600, spi_dir,      \
-						    &function, &bc_flags_ops); \
+		spi_##name = securityfs_create_file(#name, mode, spi_dir,      \
+						    data, &fops);              \
 		if (IS_ERR(spi_##name)) {                                      \
 			pr_err("Error creating securityfs file " #name "\n");  \
 			ret = PTR_ERR(spi_##name);                             \
 			goto out_##name;                                       \
 		}                                                              \
 	} while (0)
+#define create_file(name, data, fops) create_file_mode(name, 0600, data, fops)
 
-	create_file(bioswe, read_BC_BIOSWE);
-	create_file(ble, read_BC_BLE);
-	create_file(smm_bwp, read_BC_SMM_BWP);
+	create_file(bioswe, &read_BC_BIOSWE, bc_flags_ops);
+	create_file(ble, &read_BC_BLE, bc_flags_ops);
+	create_file(smm_bwp, &read_BC_SMM_BWP, bc_flags_ops);
+	create_file(summary, NULL, summary_fops);
+	create_file(snapshot, NULL, snapshot_ops);
+	create_file(snapshot_page, NULL, snapshot_page_ops);
+	create_file(protection, NULL, protection_ops);
+	create_file_mode(flash, 0400, NULL, flash_ops);
+	create_file(bios_region, NULL, bios_region_ops);
+	create_file(bios_hash, NULL, bios_hash_ops);
+	create_file(flash_merkle_root, NULL, flash_merkle_root_ops);
+	create_file(flash_merkle_leaves, NULL, flash_merkle_leaves_ops);
+	create_file(flash_index, NULL, flash_index_ops);
+	create_file(flash_changes, NULL, flash_changes_ops);
+	create_file(flash_sfdp, NULL, flash_sfdp_fops);
+	create_file(flash_descriptor, NULL, flash_descriptor_fops);
+	create_file(flash_erased, NULL, flash_erased_fops);
 
+	snapshot_notify(bc_flags_changed);
+	platform_attached = true;
 	return 0;
 
+out_flash_erased:
+	securityfs_remove(spi_flash_erased);
+out_flash_descriptor:
+	securityfs_remove(spi_flash_descriptor);
+out_flash_sfdp:
+	securityfs_remove(spi_flash_sfdp);
+out_flash_changes:
+	securityfs_remove(spi_flash_changes);
+out_flash_index:
+	securityfs_remove(spi_flash_index);
+out_flash_merkle_leaves:
+	securityfs_remove(spi_flash_merkle_leaves);
+out_flash_merkle_root:
+	securityfs_remove(spi_flash_merkle_root);
+out_bios_hash:
+	securityfs_remove(spi_bios_hash);
+out_bios_region:
+	securityfs_remove(spi_bios_region);
+out_flash:
+	securityfs_remove(spi_flash);
+out_protection:
+	securityfs_remove(spi_protection);
+out_snapshot_page:
+	securityfs_remove(spi_snapshot_page);
+out_snapshot:
+	securityfs_remove(spi_snapshot);
+out_summary:
+	securityfs_remove(spi_summary);
 out_smm_bwp:
 	securityfs_remove(spi_smm_bwp);
 out_ble:
 	securityfs_remove(spi_ble);
 out_bioswe:
 	securityfs_remove(spi_bioswe);
-	securityfs_remove(spi_dir);
+	flash_index_exit();
+	bios_hash_exit();
+	bios_window_exit();
+	flash_exit();
+	snapshot_exit();
+	mmio_unmap_window();
 	return ret;
 }
 
-static void __exit mod_exit(void)
+static void platform_detach(void)
 {
+	if (!platform_attached)
+		return;
+
+	snapshot_notify(NULL);
+
+	securityfs_remove(spi_flash_erased);
+	securityfs_remove(spi_flash_descriptor);
+	securityfs_remove(spi_flash_sfdp);
+	securityfs_remove(spi_flash_changes);
+	securityfs_remove(spi_flash_index);
+	securityfs_remove(spi_flash_merkle_leaves);
+	securityfs_remove(spi_flash_merkle_root);
+	securityfs_remove(spi_bios_hash);
+	securityfs_remove(spi_bios_region);
+	securityfs_remove(spi_flash);
+	securityfs_remove(spi_protection);
+	securityfs_remove(spi_snapshot_page);
+	securityfs_remove(spi_snapshot);
+	securityfs_remove(spi_summary);
 	securityfs_remove(spi_smm_bwp);
 	securityfs_remove(spi_ble);
 	securityfs_remove(spi_bioswe);
+	flash_index_exit();
+	bios_hash_exit();
+	bios_window_exit();
+	flash_exit();
+	snapshot_exit();
+	mmio_unmap_window();
+	platform_attached = false;
+}
+
+static ssize_t device_ids_write(struct file *filp __maybe_unused,
+				const char __user *buf, size_t count,
+				loff_t *ppos __maybe_unused)
+{
+	char *mappings;
+	ssize_t ret;
+
+	if (count >= PAGE_SIZE)
+		return -E2BIG;
+
+	mappings = memdup_user_nul(buf, count);
+	if (IS_ERR(mappings))
+		return PTR_ERR(mappings);
+
+	mutex_lock(&device_ids_lock);
+	if (device_ids_written) {
+		ret = -EPERM; /* only one write is allowed */
+		goto out;
+	}
+
+	ret = add_device_ids(mappings);
+	if (ret != 0)
+		goto out;
+	device_ids_written = true;
+
+	if (!platform_attached) {
+		if (get_pch_cpu(&pch_arch, &cpu_arch) != 0) {
+			pr_warn("Still couldn't detect PCH or CPU\n");
+			ret = -ENODEV;
+			goto out;
+		}
+		ret = platform_attach();
+		if (ret != 0)
+			goto out;
+	}
+	ret = count;
+out:
+	mutex_unlock(&device_ids_lock);
+	kfree(mappings);
+	return ret;
+}
+
+static const struct file_operations device_ids_ops = {
+	.owner = THIS_MODULE,
+	.write = device_ids_write,
+};
+
+static int __init mod_init(void)
+{
+	int ret = 0;
+
+	if (extra_ids != NULL) {
+		ret = add_device_ids(extra_ids);
+		if (ret != 0)
+			return ret;
+	}
+
+	pci_pin_devices();
+	spi_debug_dir = debugfs_create_dir(KBUILD_MODNAME, NULL);
+	mmio_debugfs_init(spi_debug_dir);
+	snapshot_debugfs_init(spi_debug_dir);
+	flash_debugfs_init(spi_debug_dir);
+
+	spi_dir = securityfs_create_dir("firmware", NULL);
+	if (IS_ERR(spi_dir)) {
+		pr_err("Couldn't create firmware securityfs dir\n");
+		ret = PTR_ERR(spi_dir);
+		goto out_debugfs;
+	}
+
+	spi_device_ids = securityfs_create_file("device_ids", 0200, spi_dir,
+						NULL, &device_ids_ops);
+	if (IS_ERR(spi_device_ids)) {
+		pr_err("Error creating securityfs file device_ids\n");
+		ret = PTR_ERR(spi_device_ids);
+		goto out_dir;
+	}
+
+	mutex_lock(&device_ids_lock);
+	if (get_pch_cpu(&pch_arch, &cpu_arch) != 0) {
+		/* stay loaded so the IDs can be added using device_ids */
+		pr_warn("Couldn't detect PCH or CPU\n");
+		ret = 0;
+	} else {
+		ret = platform_attach();
+	}
+	mutex_unlock(&device_ids_lock);
+	if (ret != 0)
+		goto out_device_ids;
+
+	return 0;
+
+out_device_ids:
+	securityfs_remove(spi_device_ids);
+out_dir:
+	securityfs_remove(spi_dir);
+out_debugfs:
+	debugfs_remove_recursive(spi_debug_dir);
+	pci_unpin_devices();
+	return ret;
+}
+
+static void __exit mod_exit(void)
+{
+	platform_detach();
+	securityfs_remove(spi_device_ids);
 	securityfs_remove(spi_dir);
+	debugfs_remove_recursive(spi_debug_dir);
+	pci_unpin_devices();
 }
 
 module_init(mod_init);
@@ -0,0 +1,45 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+/*
+ * SPI LPC flash platform security driver
+ *
+ * Copyright 2020 (c) Richard Hughes (richard@hughsie.com)
+ *
+ * This file is licensed under  the terms of the GNU General Public
+ * License version 2. This program is licensed "as is" without any
+ * warranty of any kind, whether express or implied.
+ */
+#ifndef SPI_LPC_SNAPSHOT_H
+#define SPI_LPC_SNAPSHOT_H
+
+#include <linux/types.h>
+
+/*
+ * Binary layout of /sys/kernel/security/firmware/snapshot, shared with
+ * userspace. New members are only ever appended and the version bumped.
+ */
+#define SPI_LPC_SNAPSHOT_VERSION 1
+
+struct spi_lpc_snapshot {
+	__u32 version; /* SPI_LPC_SNAPSHOT_VERSION */
+	__u32 size; /* size of this struct in bytes */
+	__u64 generation; /* snapshot generation, see the summary file */
+	__u32 pch_arch; /* enum PCH_Arch */
+	__u32 cpu_arch; /* enum CPU_Arch */
+	__u32 bc; /* raw BC register */
+	__u32 bc_valid; /* bit N set if enum BC_Field N is decoded */
+	__u32 sbase; /* raw SBASE register */
+	__u32 sbase_valid; /* bit N set if enum SBASE_Field N is decoded */
+} __attribute__((packed));
+
+/*
+ * Layout of the page mapped from /sys/kernel/security/firmware/snapshot_page.
+ * seq is odd while the kernel updates the page, so readers retry until they
+ * see the same even value before and after copying the snapshot.
+ */
+struct spi_lpc_snapshot_page {
+	__u32 seq;
+	__u32 reserved;
+	struct spi_lpc_snapshot snapshot;
+};
+
+#endif /* SPI_LPC_SNAPSHOT_H */
@@ -0,0 +1,162 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * SPI LPC flash platform security driver
+ *
+ * Hammers an attribute file from several threads and reports the read
+ * throughput and latency, to check the lock-free snapshot read path.
+ *
+ * Usage: snapshot_stress [-t threads] [-d seconds] [file]
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_FILE "/sys/kernel/security/firmware/bioswe"
+#define MAX_SAMPLES (1 << 20) /* per thread, later reads aren't timed */
+
+struct worker {
+	pthread_t thread;
+	const char *path;
+	uint64_t deadline_ns;
+	uint64_t reads;
+	uint64_t *samples;
+	size_t sample_count;
+	int error;
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void *worker_fn(void *arg)
+{
+	struct worker *w = arg;
+	char buf[16];
+	int fd;
+
+	fd = open(w->path, O_RDONLY);
+	if (fd < 0) {
+		w->error = errno;
+		return NULL;
+	}
+
+	for (;;) {
+		const uint64_t start = now_ns();
+
+		if (start >= w->deadline_ns)
+			break;
+		if (pread(fd, buf, sizeof(buf), 0) < 0) {
+			w->error = errno;
+			break;
+		}
+		if (w->sample_count < MAX_SAMPLES)
+			w->samples[w->sample_count++] = now_ns() - start;
+		w->reads++;
+	}
+	close(fd);
+
+	return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	const uint64_t x = *(const uint64_t *)a;
+	const uint64_t y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+int main(int argc, char **argv)
+{
+	const char *path = DEFAULT_FILE;
+	unsigned int threads = 8;
+	unsigned int seconds = 5;
+	struct worker *workers;
+	uint64_t *all;
+	uint64_t reads = 0;
+	size_t count = 0;
+	uint64_t deadline;
+	unsigned int i;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "t:d:")) != -1) {
+		switch (opt) {
+		case 't':
+			threads = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			seconds = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr,
+				"Usage: %s [-t threads] [-d seconds] [file]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+	if (optind < argc)
+		path = argv[optind];
+	if (threads == 0 || seconds == 0)
+		return 1;
+
+	workers = calloc(threads, sizeof(*workers));
+	if (workers == NULL)
+		return 1;
+
+	deadline = now_ns() + (uint64_t)seconds * 1000000000;
+	for (i = 0; i < threads; i++) {
+		workers[i].path = path;
+		workers[i].deadline_ns = deadline;
+		workers[i].samples = malloc(MAX_SAMPLES * sizeof(uint64_t));
+		if (workers[i].samples == NULL)
+			return 1;
+		pthread_create(&workers[i].thread, NULL, worker_fn,
+			       &workers[i]);
+	}
+	for (i = 0; i < threads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		if (workers[i].error != 0) {
+			fprintf(stderr, "%s: %s\n", path,
+				strerror(workers[i].error));
+			return 1;
+		}
+		reads += workers[i].reads;
+		count += workers[i].sample_count;
+	}
+
+	all = malloc(count * sizeof(uint64_t) + 1);
+	if (all == NULL)
+		return 1;
+	count = 0;
+	for (i = 0; i < threads; i++) {
+		memcpy(all + count, workers[i].samples,
+		       workers[i].sample_count * sizeof(uint64_t));
+		count += workers[i].sample_count;
+		free(workers[i].samples);
+	}
+	qsort(all, count, sizeof(uint64_t), cmp_u64);
+
+	printf("threads=%u\n", threads);
+	printf("reads_per_sec=%llu\n", (unsigned long long)(reads / seconds));
+	if (count > 0) {
+		printf("p50_ns=%llu\n", (unsigned long long)all[count / 2]);
+		printf("p99_ns=%llu\n",
+		       (unsigned long long)all[count * 99 / 100]);
+	}
+
+	free(all);
+	free(workers);
+	return 0;
+}